@@ -0,0 +1,140 @@
+// Push and drain throughput of AsyncQueue with 1 to 16 producer threads, against the mutex and
+// std::function queue it replaced. The event loop runs on the main thread and drains, every
+// producer pushes kTasks / producers tasks as fast as it can.
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <event/event_loop.h>
+#include <fmt/format.h>
+
+#include "process/async_queue.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kTasks = 2'000'000;
+
+// the previous AsyncQueue: a mutex, a std::queue of std::function and an eventfd write per push
+class MutexQueue {
+public:
+  explicit MutexQueue(Core::Event::EventLoop *loop) : event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    event_ = event_new(loop->getEventBase(), event_fd_, EV_READ | EV_PERSIST, CallbackFn, this);
+    event_add(event_, nullptr);
+  }
+
+  ~MutexQueue() {
+    event_free(event_);
+    close(event_fd_);
+  }
+
+  void Push(std::function<void()> &&task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push(std::move(task));
+    }
+    uint64_t one = 1;
+    (void)!write(event_fd_, &one, sizeof(one));
+  }
+
+private:
+  static void CallbackFn(evutil_socket_t fd, short, void *arg) {
+    uint64_t value;
+    while (read(fd, &value, sizeof(value)) > 0) {
+    }
+    auto queue = static_cast<MutexQueue *>(arg);
+    std::queue<std::function<void()>> tasks;
+    {
+      std::lock_guard<std::mutex> lock(queue->mutex_);
+      tasks.swap(queue->tasks_);
+    }
+    while (!tasks.empty()) {
+      tasks.front()();
+      tasks.pop();
+    }
+  }
+
+  int event_fd_;
+  event *event_;
+  std::mutex mutex_;
+  std::queue<std::function<void()>> tasks_;
+};
+
+struct Result {
+  double pushSeconds;
+  // until the loop has run every task
+  double doneSeconds;
+};
+
+// a closure of a few pointers, like the ones the config client pushes
+struct Payload {
+  size_t *executed;
+  size_t total;
+  event_base *base;
+
+  void operator()() const {
+    if (++*executed == total) {
+      event_base_loopbreak(base);
+    }
+  }
+};
+
+template <typename Queue> Result Run(Core::Event::EventLoop *loop, Queue &queue, size_t producers) {
+  size_t executed = 0;
+  const size_t perProducer = kTasks / producers;
+  const size_t total = perProducer * producers;
+  std::atomic<bool> go{false};
+  std::atomic<int64_t> pushEnd{0};
+  std::vector<std::thread> threads;
+  for (size_t p = 0; p < producers; p++) {
+    threads.emplace_back([&]() {
+      while (!go.load(std::memory_order_acquire)) {
+      }
+      for (size_t i = 0; i < perProducer; i++) {
+        queue.Push(Payload{&executed, total, loop->getEventBase()});
+      }
+      auto now = Clock::now().time_since_epoch().count();
+      auto last = pushEnd.load();
+      while (now > last && !pushEnd.compare_exchange_weak(last, now)) {
+      }
+    });
+  }
+
+  auto start = Clock::now();
+  go.store(true, std::memory_order_release);
+  event_base_dispatch(loop->getEventBase());
+  auto end = Clock::now();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto pushed = Clock::time_point(Clock::duration(pushEnd.load()));
+  return {std::chrono::duration<double>(pushed - start).count(), std::chrono::duration<double>(end - start).count()};
+}
+
+void Print(const char *name, size_t producers, const Result &result) {
+  fmt::print("{:<8} producers={:<3} push={:>7.2f}M/s done={:>7.2f}M/s\n", name, producers,
+             kTasks / result.pushSeconds / 1e6, kTasks / result.doneSeconds / 1e6);
+}
+} // namespace
+
+int main() {
+  fmt::print("{} tasks per run, {} hardware threads\n", kTasks, std::thread::hardware_concurrency());
+  for (size_t producers : {1, 2, 4, 8, 16}) {
+    auto loop = std::make_shared<Core::Event::EventLoop>();
+    Core::Event::AsyncQueue queue(loop.get());
+    Print("lockfree", producers, Run(loop.get(), queue, producers));
+    fmt::print("{:<8} budget yields={}\n", "", queue.Yields());
+
+    auto mutexLoop = std::make_shared<Core::Event::EventLoop>();
+    MutexQueue mutexQueue(mutexLoop.get());
+    Print("mutex", producers, Run(mutexLoop.get(), mutexQueue, producers));
+  }
+  return 0;
+}
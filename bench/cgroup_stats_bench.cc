@@ -0,0 +1,82 @@
+// CPU time of sampling 1000 cgroups, the way CGroupRegistry::Sample does every interval_ms. The
+// cgroups are created empty under watchermen-bench/ (needs root) and removed afterwards, so the
+// numbers are for leaf cgroups; argv[1] sets the number of cgroups.
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "process/cgroup_registry.h"
+#include "process/cgroup_stats.h"
+
+namespace {
+constexpr const char *kParent = "watchermen-bench";
+constexpr int kRounds = 20;
+// every hierarchy CGroupStats reads from on cgroup v1, one directory on v2
+constexpr const char *kControllers[] = {"cpu", "memory", "pids"};
+
+double CpuSeconds() {
+  struct rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  using App::Process::CGroupRegistry;
+  int count = argc > 1 ? atoi(argv[1]) : 1000;
+  // up to seven fds per cgroup
+  struct rlimit limit {static_cast<rlim_t>(count) * 8 + 64, static_cast<rlim_t>(count) * 8 + 64};
+  setrlimit(RLIMIT_NOFILE, &limit);
+
+  std::vector<std::string> names;
+  for (int i = 0; i < count; i++) {
+    names.push_back(fmt::format("{}/service-{}", kParent, i));
+  }
+  for (const char *controller : kControllers) {
+    mkdir(CGroupRegistry::Directory(kParent, controller).c_str(), 0755);
+    for (auto &name : names) {
+      if (mkdir(CGroupRegistry::Directory(name, controller).c_str(), 0755) == -1 && errno != EEXIST) {
+        fmt::print("create {} failed, run as root\n", CGroupRegistry::Directory(name, controller));
+        return 1;
+      }
+    }
+  }
+
+  {
+    std::vector<std::unique_ptr<App::Process::CGroupStats>> stats;
+    for (auto &name : names) {
+      stats.push_back(std::make_unique<App::Process::CGroupStats>(name, CGroupRegistry::Unified(), 60));
+    }
+    // the first round opens the files
+    for (auto &cgroup : stats) {
+      cgroup->Sample(0);
+    }
+    double cpu = CpuSeconds();
+    auto begin = std::chrono::steady_clock::now();
+    for (int round = 1; round <= kRounds; round++) {
+      for (auto &cgroup : stats) {
+        cgroup->Sample(round);
+      }
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() / kRounds;
+    cpu = (CpuSeconds() - cpu) / kRounds;
+    fmt::print("{} cgroups (cgroup {}): {:.0f}us wall, {:.0f}us cpu per round, {:.2f}% of a core at 1s\n", count,
+               CGroupRegistry::Unified() ? "v2" : "v1", wall * 1e6, cpu * 1e6, cpu * 100);
+  }
+
+  for (const char *controller : kControllers) {
+    for (auto &name : names) {
+      rmdir(CGroupRegistry::Directory(name, controller).c_str());
+    }
+    rmdir(CGroupRegistry::Directory(kParent, controller).c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+// Cold-start load time of a config with 10 to 10k services: the JSON file parsed the way
+// Config::ReadConfig does, against the binary cache loaded by ConfigCache. Both files are dropped
+// from the page cache before every load (posix_fadvise, best effort), the median of kRounds loads
+// is reported. The files are written to the directory in argv[1], default /tmp.
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <fmt/format.h>
+#include <google/protobuf/util/json_util.h>
+
+#include "process/config_cache.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr int kRounds = 9;
+
+ManagerConfig MakeConfig(int services) {
+  ManagerConfig config;
+  config.set_log_level("info");
+  config.mutable_network()->set_host("127.0.0.1");
+  config.mutable_cgroup()->set_enabled(true);
+  config.mutable_cgroup()->set_name("watchermen");
+  for (int i = 0; i < services; i++) {
+    auto service = config.add_service();
+    service->set_process_name(fmt::format("service-{}", i));
+    service->set_command(fmt::format("/usr/local/bin/service-{0} --config /etc/service-{0}.yaml", i));
+    service->set_autostart(true);
+    service->set_numprocs(1);
+    service->set_stdout_logfile(fmt::format("/var/log/service-{}.log", i));
+    service->set_config_path(fmt::format("/etc/service-{}.yaml", i));
+    service->set_config(std::string(256, 'x'));
+    service->mutable_cgroup()->set_enabled(true);
+    service->mutable_cgroup()->set_memory(512);
+    service->mutable_cgroup()->set_cpu(0.5);
+    service->mutable_restart()->set_max_restarts(5);
+  }
+  return config;
+}
+
+void DropCache(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd != -1) {
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+// what Config::ReadConfig does
+bool ParseJson(const std::string &path, ManagerConfig *config) {
+  std::ifstream istream(path);
+  std::stringstream buffer;
+  buffer << istream.rdbuf();
+  google::protobuf::util::JsonParseOptions options;
+  options.ignore_unknown_fields = true;
+  return google::protobuf::util::JsonStringToMessage(buffer.str(), config, options).ok();
+}
+
+template <typename Fn> double MedianMicros(const std::string &path, Fn &&load) {
+  std::vector<double> micros;
+  for (int i = 0; i < kRounds; i++) {
+    DropCache(path);
+    ManagerConfig config;
+    auto begin = Clock::now();
+    if (!load(&config)) {
+      return -1;
+    }
+    micros.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+  }
+  std::sort(micros.begin(), micros.end());
+  return micros[micros.size() / 2];
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string dir = argc > 1 ? argv[1] : "/tmp";
+  std::string path = dir + "/config_cache_bench.json";
+  for (int services : {10, 100, 1000, 10000}) {
+    auto config = MakeConfig(services);
+    std::string json;
+    google::protobuf::util::MessageToJsonString(config, &json);
+    {
+      std::ofstream file(path, std::ios::trunc);
+      file << json;
+    }
+
+    App::Process::ConfigCache cache(path);
+    App::Process::FileIdentity source;
+    if (!App::Process::FileIdentity::Of(path, &source) || !cache.Store(config, source)) {
+      fmt::print("write the cache of {} failed\n", path);
+      return 1;
+    }
+
+    double jsonMicros = MedianMicros(path, [&path](ManagerConfig *loaded) { return ParseJson(path, loaded); });
+    double cacheMicros = MedianMicros(cache.path(), [&cache](ManagerConfig *loaded) { return cache.Load(loaded); });
+    fmt::print("services={:<6} json={:>8} bytes {:>10.0f}us  cache={:>10.0f}us  {:.1f}x\n", services, json.size(),
+               jsonMicros, cacheMicros, jsonMicros / cacheMicros);
+    cache.Remove();
+  }
+  unlink(path.c_str());
+  return 0;
+}
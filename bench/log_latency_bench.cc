@@ -0,0 +1,138 @@
+// Event-loop latency while the loop logs in bursts, synchronous logging against the async logger
+// Config::StartAsyncLog sets up. A 1 ms timer measures how late the loop wakes up, every 200 ms a
+// burst of kBurst lines is logged from the loop, the way a reload of many services logs. Both
+// write a LogFileSink in the directory in argv[1] (default /tmp) with the defaults of the config:
+// sync flushes every line, async flushes warn and above and leaves the rest to the worker.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include <event2/event.h>
+#include <fmt/format.h>
+#include <spdlog/async.h>
+#include <spdlog/spdlog.h>
+
+#include "process/log_file_sink.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr int kRunSeconds = 3;
+constexpr int kBurst = 5000;
+constexpr auto kTick = std::chrono::milliseconds(1);
+constexpr auto kBurstEvery = std::chrono::milliseconds(200);
+// kDefaultLogQueueSize of config.cc
+constexpr size_t kQueueSize = 8192;
+
+struct Bench {
+  event_base *base;
+  spdlog::logger *logger;
+  event *tick;
+  event *burst;
+  Clock::time_point armed;
+  std::vector<double> lateMicros;
+  std::vector<double> burstMicros;
+  int lines = 0;
+};
+
+timeval ToTimeval(std::chrono::microseconds micros) {
+  return {static_cast<time_t>(micros.count() / 1000000), static_cast<suseconds_t>(micros.count() % 1000000)};
+}
+
+void OnTick(evutil_socket_t, short, void *arg) {
+  auto bench = static_cast<Bench *>(arg);
+  auto now = Clock::now();
+  bench->lateMicros.push_back(std::chrono::duration<double, std::micro>(now - bench->armed - kTick).count());
+  bench->armed = now;
+  timeval tv = ToTimeval(kTick);
+  evtimer_add(bench->tick, &tv);
+}
+
+void OnBurst(evutil_socket_t, short, void *arg) {
+  auto bench = static_cast<Bench *>(arg);
+  auto begin = Clock::now();
+  for (int i = 0; i < kBurst; i++) {
+    SPDLOG_LOGGER_INFO(bench->logger, "process service-{} changed, status={}, pid={}, restarts={}", bench->lines % 1000,
+                       "RUNNING", 10000 + bench->lines, bench->lines % 7);
+    bench->lines++;
+  }
+  bench->burstMicros.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+}
+
+double Percentile(std::vector<double> values, double p) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, static_cast<size_t>(values.size() * p))];
+}
+
+void Run(const char *name, const std::shared_ptr<spdlog::logger> &logger) {
+  logger->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] [%s:%#] %v");
+  Bench bench{};
+  bench.base = event_base_new();
+  bench.logger = logger.get();
+  bench.tick = evtimer_new(bench.base, OnTick, &bench);
+  bench.burst = event_new(bench.base, -1, EV_PERSIST, OnBurst, &bench);
+  timeval tick = ToTimeval(kTick);
+  timeval burst = ToTimeval(kBurstEvery);
+  timeval stop = ToTimeval(std::chrono::seconds(kRunSeconds));
+  bench.armed = Clock::now();
+  evtimer_add(bench.tick, &tick);
+  evtimer_add(bench.burst, &burst);
+  event_base_loopexit(bench.base, &stop);
+  event_base_dispatch(bench.base);
+
+  fmt::print("{:<6} late p50={:>7.0f}us p99={:>7.0f}us max={:>7.0f}us  burst of {} lines p50={:>7.0f}us\n", name,
+             Percentile(bench.lateMicros, 0.5), Percentile(bench.lateMicros, 0.99),
+             Percentile(bench.lateMicros, 1.0), kBurst, Percentile(bench.burstMicros, 0.5));
+  event_free(bench.burst);
+  event_free(bench.tick);
+  event_base_free(bench.base);
+}
+
+// each run in its own process with its own log file
+template <typename Fn> void Isolated(Fn &&fn) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    fn();
+    fflush(stdout);
+    _exit(0);
+  }
+  waitpid(pid, nullptr, 0);
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string path = std::string(argc > 1 ? argv[1] : "/tmp") + "/log_latency_bench.log";
+  fmt::print("1 ms timer, {} lines every {} ms, {}s each\n", kBurst, kBurstEvery.count(), kRunSeconds);
+  Isolated([&path]() {
+    unlink(path.c_str());
+    auto sink = std::make_shared<App::Process::LogFileSink>(path, App::Process::LogFileSink::Options{});
+    sink->Start();
+    auto logger = std::make_shared<spdlog::logger>("sync", sink);
+    logger->flush_on(spdlog::level::trace);
+    Run("sync", logger);
+  });
+  Isolated([&path]() {
+    unlink(path.c_str());
+    auto sink = std::make_shared<App::Process::LogFileSink>(path, App::Process::LogFileSink::Options{});
+    sink->Start();
+    auto pool = std::make_shared<spdlog::details::thread_pool>(kQueueSize, 1);
+    auto logger = std::make_shared<spdlog::async_logger>("async", sink, pool, spdlog::async_overflow_policy::block);
+    logger->flush_on(spdlog::level::warn);
+    // flush_every flushes the registered loggers
+    spdlog::register_logger(logger);
+    spdlog::flush_every(std::chrono::seconds(1));
+    Run("async", logger);
+    spdlog::shutdown();
+  });
+  unlink(path.c_str());
+  return 0;
+}
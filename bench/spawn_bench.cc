@@ -0,0 +1,131 @@
+// Spawn latency of 500 children of /bin/true, p50 and p99 of the time until the spawning call
+// returned in the parent ("call") and until the child has exited ("done"):
+// - spawner: Spawner, the child joins the cgroups itself before execve
+// - libcore: what Core::Component::Process::Process::execute did before, fork, /bin/sh -c in the
+//   child, and the parent writes the pid into cgroup.procs after fork returned
+// - fork+exec: fork + execve without shell and cgroup, a lower bound for any fork based path
+// fork returns before the child has exec'ed, so "call" of the fork based paths leaves out the
+// exec that Spawner's call includes, compare "done" for the whole cost. The supervisor touches
+// rss_mb MB first (argv[1], default 256): fork copies page tables proportional to it, the
+// vfork-style clone does not. argv[2..] are cgroup directories to put the children in (existing,
+// needs root), one per v1 hierarchy or the v2 one, without them no path joins a cgroup.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "process/spawner.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kChildren = 500;
+
+char kTrue[] = "/bin/true";
+char *const kArgv[] = {kTrue, nullptr};
+char *const kEnvp[] = {nullptr};
+
+std::vector<std::string> cgroupProcs;
+
+pid_t LibcoreExecute() {
+  pid_t pid = fork();
+  if (pid == 0) {
+    execl("/bin/sh", "sh", "-c", kTrue, nullptr);
+    _exit(127);
+  }
+  // the child is already running outside its cgroups here
+  std::string value = std::to_string(pid);
+  for (auto &path : cgroupProcs) {
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd == -1 || write(fd, value.data(), value.size()) != static_cast<ssize_t>(value.size())) {
+      fmt::print("attach to {} failed: {}\n", path, strerror(errno));
+    }
+    if (fd != -1) {
+      close(fd);
+    }
+  }
+  return pid;
+}
+
+pid_t ForkExec() {
+  pid_t pid = fork();
+  if (pid == 0) {
+    execve(kTrue, kArgv, kEnvp);
+    _exit(127);
+  }
+  return pid;
+}
+
+pid_t Spawn(App::Process::Spawner &spawner, const std::vector<int> &procsFds) {
+  App::Process::SpawnRequest request;
+  request.path = kTrue;
+  request.argv = kArgv;
+  request.envp = kEnvp;
+  request.cgroupProcsFds = procsFds;
+  int pidfd = -1;
+  pid_t pid = spawner.spawn(request, &pidfd);
+  if (pidfd != -1) {
+    close(pidfd);
+  }
+  return pid;
+}
+
+template <typename Fn> void Run(const char *name, Fn &&spawn) {
+  std::vector<double> call;
+  std::vector<double> done;
+  call.reserve(kChildren);
+  done.reserve(kChildren);
+  for (size_t i = 0; i < kChildren; i++) {
+    auto begin = Clock::now();
+    pid_t pid = spawn();
+    auto end = Clock::now();
+    if (pid <= 0) {
+      fmt::print("{} failed: {}\n", name, strerror(pid < 0 ? -pid : errno));
+      return;
+    }
+    waitpid(pid, nullptr, 0);
+    call.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+    done.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+  }
+  std::sort(call.begin(), call.end());
+  std::sort(done.begin(), done.end());
+  fmt::print("{:<10} call p50={:>7.1f}us p99={:>7.1f}us  done p50={:>7.1f}us p99={:>7.1f}us\n", name,
+             call[call.size() / 2], call[call.size() * 99 / 100], done[done.size() / 2],
+             done[done.size() * 99 / 100]);
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  size_t rssMb = argc > 1 ? strtoull(argv[1], nullptr, 10) : 256;
+  std::vector<char> rss(rssMb * 1024 * 1024);
+  for (size_t i = 0; i < rss.size(); i += 4096) {
+    rss[i] = 1;
+  }
+  std::vector<int> procsFds;
+  for (int i = 2; i < argc; i++) {
+    cgroupProcs.push_back(std::string(argv[i]) + "/cgroup.procs");
+    int fd = open(cgroupProcs.back().c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd == -1) {
+      fmt::print("open {} failed: {}\n", cgroupProcs.back(), strerror(errno));
+      return 1;
+    }
+    procsFds.push_back(fd);
+  }
+  fmt::print("{} children, supervisor rss {} MB, {} cgroups\n", kChildren, rssMb, procsFds.size());
+
+  App::Process::Spawner spawner;
+  Run("spawner", [&spawner, &procsFds]() { return Spawn(spawner, procsFds); });
+  Run("libcore", []() { return LibcoreExecute(); });
+  Run("fork+exec", []() { return ForkExec(); });
+  for (int fd : procsFds) {
+    close(fd);
+  }
+  return 0;
+}
@@ -0,0 +1,151 @@
+// 10k concurrently armed timers on one TimerWheel against one libevent timer per timer, which is
+// what a Core::Component::TimerChannel per timer costs. Every timer rearms itself with a random
+// 100 ms to 1 s timeout, like heartbeats and restart backoffs, for kRunSeconds. Reports the CPU
+// time of the whole run, the cost of one arm + cancel and the RSS taken by the armed timers.
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include <event/event_loop.h>
+#include <fmt/format.h>
+
+#include "process/timer_wheel.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kTimers = 10'000;
+constexpr int kRunSeconds = 5;
+
+std::chrono::milliseconds RandomTimeout(std::mt19937 &rng) { return std::chrono::milliseconds(100 + rng() % 900); }
+
+double CpuSeconds() {
+  struct rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// resident set in KB right now, ru_maxrss only grows
+long RssKb() {
+  long pages = 0;
+  long resident = 0;
+  FILE *file = fopen("/proc/self/statm", "r");
+  if (file != nullptr) {
+    if (fscanf(file, "%ld %ld", &pages, &resident) != 2) {
+      resident = 0;
+    }
+    fclose(file);
+  }
+  return resident * sysconf(_SC_PAGESIZE) / 1024;
+}
+
+// one event per timer, enable adds it with a timeout, like TimerChannel
+class EventTimer {
+public:
+  EventTimer(event_base *base, std::function<void()> callback) : callback_(std::move(callback)) {
+    event_ = evtimer_new(base, CallbackFn, this);
+  }
+  ~EventTimer() { event_free(event_); }
+
+  void enable(std::chrono::milliseconds timeout) {
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(timeout).count();
+    struct timeval tv {static_cast<time_t>(micros / 1000000), static_cast<suseconds_t>(micros % 1000000)};
+    evtimer_add(event_, &tv);
+  }
+  void disable() { evtimer_del(event_); }
+
+private:
+  static void CallbackFn(evutil_socket_t, short, void *arg) { static_cast<EventTimer *>(arg)->callback_(); }
+
+  event *event_;
+  std::function<void()> callback_;
+};
+
+struct Result {
+  double armCancelNanos;
+  long rssKb;
+  double cpuSeconds;
+  size_t fired;
+};
+
+template <typename Timer, typename Make> Result Run(Core::Event::EventLoop *loop, Make &&make) {
+  std::mt19937 rng(1);
+  size_t fired = 0;
+  std::vector<std::unique_ptr<Timer>> timers;
+  timers.reserve(kTimers);
+
+  long rssBefore = RssKb();
+  for (size_t i = 0; i < kTimers; i++) {
+    timers.push_back(make([&, i]() {
+      fired++;
+      timers[i]->enable(RandomTimeout(rng));
+    }));
+  }
+  for (auto &timer : timers) {
+    timer->enable(RandomTimeout(rng));
+  }
+  long rssArmed = RssKb();
+
+  // rearm every timer once more, it is cancelled first
+  auto begin = Clock::now();
+  for (auto &timer : timers) {
+    timer->disable();
+    timer->enable(RandomTimeout(rng));
+  }
+  double armCancel = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / kTimers;
+
+  double cpu = CpuSeconds();
+  struct timeval stop {kRunSeconds, 0};
+  event_base_loopexit(loop->getEventBase(), &stop);
+  event_base_dispatch(loop->getEventBase());
+  cpu = CpuSeconds() - cpu;
+
+  for (auto &timer : timers) {
+    timer->disable();
+  }
+  return {armCancel, rssArmed - rssBefore, cpu, fired};
+}
+
+void Print(const char *name, const Result &result) {
+  fmt::print("{:<8} arm+cancel={:>6.0f}ns rss={:>6}KB cpu={:>6.3f}s ({:.2f}% of a core) fired={}\n", name,
+             result.armCancelNanos, result.rssKb, result.cpuSeconds, result.cpuSeconds * 100 / kRunSeconds,
+             result.fired);
+}
+
+// each run in its own process, so the heap grown by one does not hide the RSS of the other
+template <typename Fn> void Isolated(Fn &&fn) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    fn();
+    fflush(stdout);
+    _exit(0);
+  }
+  waitpid(pid, nullptr, 0);
+}
+} // namespace
+
+int main() {
+  fmt::print("{} timers, {}s each\n", kTimers, kRunSeconds);
+  Isolated([]() {
+    auto loop = std::make_shared<Core::Event::EventLoop>();
+    Core::Event::TimerWheel wheel(loop.get());
+    Print("wheel", Run<Core::Event::WheelTimer>(loop.get(), [&wheel](std::function<void()> callback) {
+            return std::make_unique<Core::Event::WheelTimer>(&wheel, std::move(callback));
+          }));
+  });
+  Isolated([]() {
+    auto loop = std::make_shared<Core::Event::EventLoop>();
+    auto base = loop->getEventBase();
+    Print("libevent", Run<EventTimer>(loop.get(), [base](std::function<void()> callback) {
+            return std::make_unique<EventTimer>(base, std::move(callback));
+          }));
+  });
+  return 0;
+}
@@ -1,4 +1,5 @@
-set(PROTO_PATH "${PROJECT_SOURCE_DIR}/third_party/nova-agent-payload/agent/protobuf")
+# the config schema of watchermen is kept in this repository, not in nova-agent-payload
+set(PROTO_PATH "${PROJECT_SOURCE_DIR}/proto")
 set(GENERATED_PROTOBUF_PATH "${CMAKE_BINARY_DIR}/generated/")
 
 set(MANAGER_PROTO "${PROTO_PATH}/watchermen/v1/manager.proto")
@@ -34,6 +35,7 @@ add_custom_command(
         COMMAND
         ${_watchermen_PROTOBUF_PROTOC_EXECUTABLE} ${PROTOBUF_COMMON_FLAGS}
         ${PROTOBUF_INCLUDE_FLAGS} ${MANAGER_PROTO}
+        DEPENDS ${MANAGER_PROTO}
         COMMENT "[Run]: ${_watchermen_PROTOBUF_PROTOC_EXECUTABLE}")
 include_directories(${GENERATED_PROTOBUF_PATH})
 add_library(
@@ -22,6 +22,14 @@ protobuf_generate(
     PROTOC_OUT_DIR "${CONTROLLER_GENERATED_PATH}"
 )
 
+# the heartbeat reports OOM kills once ProcessInfo in nova-agent-payload has the oomkills field
+file(STRINGS "${CONTROLLER_PROTO_PATH}/grpc/agent/v1/controller.proto" CONTROLLER_OOMKILLS REGEX "[ \t]oomkills[ \t]*=")
+if(CONTROLLER_OOMKILLS)
+    add_compile_definitions(WATCHERMEN_HEARTBEAT_OOMKILLS)
+else()
+    message(STATUS "ProcessInfo.oomkills is not in controller.proto, OOM kills are not reported in the heartbeat")
+endif()
+
 add_library(
     controller_config_proto
     "${CONTROLLER_GENERATED_PATH}/grpc/agent/v1/controller.pb.cc"
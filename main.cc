@@ -157,9 +157,9 @@ int main(int argc, char **argv) {
   }
 
   std::shared_ptr<App::Process::Config> manager_config = std::make_shared<App::Process::Config>(config_file);
-  auto &config = manager_config->GetConfig();
+  auto config = manager_config->Snapshot();
 
-  if (config.daemon()) {
+  if (config->daemon()) {
     Daemonize();
   } else {
     if (CreatePidFile(kPidFile) != 0) {
@@ -167,6 +167,8 @@ int main(int argc, char **argv) {
       exit(-1);
     }
   }
+  // the log worker thread has to be started in the daemonized process
+  manager_config->StartAsyncLog();
   std::shared_ptr<App::Process::Manager> manager = std::make_shared<App::Process::Manager>(manager_config);
 
   std::unique_ptr<Core::Component::Container> container = std::make_unique<Core::Component::Container>();
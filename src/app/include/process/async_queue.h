@@ -1,30 +1,237 @@
 #pragma once
 #include <event/event_loop.h>
 #include <event/event_smart_ptr.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "process/histogram.h"
 
 namespace Core::Event {
+/**
+ * Move-only callable with inline storage. Closures up to kInlineSize bytes are stored in place,
+ * larger ones fall back to a single heap allocation.
+ */
+class Task {
+public:
+  static constexpr size_t kInlineSize = 48;
+
+  Task() noexcept = default;
+
+  template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+  Task(F &&fn) { // NOLINT(google-explicit-constructor)
+    using Fn = std::decay_t<F>;
+    if constexpr (IsInline<Fn>()) {
+      new (storage_) Fn(std::forward<F>(fn));
+      ops_ = &kInlineOps<Fn>;
+    } else {
+      *reinterpret_cast<Fn **>(storage_) = new Fn(std::forward<F>(fn));
+      ops_ = &kHeapOps<Fn>;
+    }
+  }
+
+  Task(Task &&other) noexcept { MoveFrom(other); }
+
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      Reset();
+      MoveFrom(other);
+    }
+    return *this;
+  }
+
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+
+  ~Task() { Reset(); }
+
+  void operator()() { ops_->invoke(storage_); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  void Reset() {
+    if (ops_) {
+      ops_->destroy(storage_);
+      ops_ = nullptr;
+    }
+  }
+
+private:
+  struct Ops {
+    void (*invoke)(void *);
+    void (*move)(void *src, void *dst);
+    void (*destroy)(void *);
+  };
+
+  template <typename Fn> static constexpr bool IsInline() {
+    return sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(std::max_align_t) &&
+           std::is_nothrow_move_constructible_v<Fn>;
+  }
+
+  template <typename Fn>
+  static constexpr Ops kInlineOps = {
+      [](void *p) { (*static_cast<Fn *>(p))(); },
+      [](void *src, void *dst) {
+        new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+        static_cast<Fn *>(src)->~Fn();
+      },
+      [](void *p) { static_cast<Fn *>(p)->~Fn(); }};
+
+  template <typename Fn>
+  static constexpr Ops kHeapOps = {
+      [](void *p) { (**static_cast<Fn **>(p))(); },
+      [](void *src, void *dst) { *static_cast<Fn **>(dst) = *static_cast<Fn **>(src); },
+      [](void *p) { delete *static_cast<Fn **>(p); }};
+
+  void MoveFrom(Task &other) noexcept {
+    if (other.ops_) {
+      other.ops_->move(other.storage_, storage_);
+      ops_ = other.ops_;
+      other.ops_ = nullptr;
+    }
+  }
+
+  alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+  const Ops *ops_ = nullptr;
+};
+
+/**
+ * Bounded lock-free multi-producer/single-consumer task queue.
+ *
+ * Producers claim a slot with a CAS on tail_ and publish it through the slot sequence number, the
+ * consumer never takes a lock on the fast path. When the ring is full, tasks spill into a mutex
+ * protected overflow list; once spilling has started every producer keeps spilling until the
+ * consumer has drained the ring up to the spill point, so per-producer FIFO order is preserved.
+ */
+class TaskQueue {
+public:
+  explicit TaskQueue(size_t capacity);
+  ~TaskQueue() = default;
+
+  TaskQueue(const TaskQueue &) = delete;
+  TaskQueue &operator=(const TaskQueue &) = delete;
+
+  // thread safe, stamp is an opaque value handed back by Pop (the enqueue time)
+  void Push(Task &&task, int64_t stamp);
+
+  // consumer only, returns false when the queue is empty
+  bool Pop(Task &task, int64_t &stamp);
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> seq{0};
+    int64_t stamp = 0;
+    Task task;
+  };
+
+  struct Spilled {
+    Task task;
+    int64_t stamp;
+  };
+
+  bool TryPushRing(Task &task, int64_t stamp);
+  bool TryPopRing(Task &task, int64_t &stamp, bool wait);
+
+private:
+  const uint64_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  alignas(64) uint64_t head_ = 0;
+
+  // overflow path
+  std::mutex spill_mutex_;
+  std::deque<Spilled> spill_;
+  std::atomic<bool> spilling_{false};
+  // consumer owned copy of spill_ and the ring position that must be drained before it
+  std::deque<Spilled> spill_batch_;
+  uint64_t spill_fence_ = 0;
+};
+
+/**
+ * Lanes are drained strictly in order: control commands and child exits first, bulk work
+ * (such as applying a pushed config) last.
+ */
+enum class TaskPriority : uint8_t {
+  kControl = 0,
+  kNormal = 1,
+  kBulk = 2,
+};
+
+constexpr size_t kTaskPriorityCount = 3;
+
+/**
+ * Cross-thread task queue drained on the event loop. A single drain runs at most
+ * Budget::max_tasks tasks or Budget::max_time, then yields back to libevent and resumes on the
+ * next loop iteration, so signals, timers and the http server are not starved by a long backlog.
+ */
 class AsyncQueue {
   static void CallbackFn(evutil_socket_t, short, void *handler);
+  static void ResumeFn(evutil_socket_t, short, void *handler);
 
 public:
-  explicit AsyncQueue(EventLoop *loop);
+  static constexpr size_t kDefaultCapacity = 1024;
+
+  struct Budget {
+    size_t max_tasks = 64;
+    std::chrono::microseconds max_time{2000};
+  };
+
+  explicit AsyncQueue(EventLoop *loop, size_t capacity = kDefaultCapacity);
   ~AsyncQueue();
 
   // Push a task to the queue, thread safe
-  void Push(std::function<void()> &&task);
+  void Push(Task &&task, TaskPriority priority = TaskPriority::kNormal);
+
+  void SetBudget(const Budget &budget) { budget_ = budget; }
+  // asked for the budget at the start of every drain, so a reloaded config applies to the next one
+  void SetBudgetSource(std::function<Budget()> source) { budget_source_ = std::move(source); }
+
+  // number of tasks waiting in a lane
+  uint64_t Depth(TaskPriority priority) const;
+  // time the tasks of a lane spent in the queue between Push and execution
+  const App::Process::LatencyHistogram &WaitTime(TaskPriority priority) const {
+    return lanes_[static_cast<size_t>(priority)]->wait_time;
+  }
+  // number of drains cut short by the budget
+  uint64_t Yields() const { return yields_.load(std::memory_order_relaxed); }
 
 private:
+  struct Lane;
+
   void Notify() const;
   void Process();
+  // the lane the task was taken from, nullptr when all lanes are empty
+  Lane *PopNext(Task &task, int64_t &stamp);
+
+  static int64_t Now() { return std::chrono::steady_clock::now().time_since_epoch().count(); }
 
 private:
+  struct Lane {
+    explicit Lane(size_t capacity) : tasks(capacity) {}
+    TaskQueue tasks;
+    std::atomic<uint64_t> pushed{0};
+    std::atomic<uint64_t> popped{0};
+    App::Process::LatencyHistogram wait_time;
+  };
+
   int event_fd_;
   EventLoop *loop_;
   EventPtr event_;
-  std::mutex mutex_;
-  std::queue<std::function<void()>> tasks_;
+  EventPtr resume_event_;
+  std::array<std::unique_ptr<Lane>, kTaskPriorityCount> lanes_;
+  Budget budget_;
+  std::function<Budget()> budget_source_;
+  std::atomic<uint64_t> yields_{0};
+  // set by the producer which makes the queue non-empty, cleared by the consumer before draining
+  alignas(64) std::atomic<bool> signaled_{false};
 };
-} // namespace Core::Event
\ No newline at end of file
+} // namespace Core::Event
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <absl/container/flat_hash_map.h>
+
+#include "cgroup_stats.h"
+#include "os/unix_cgroup.h"
+
+namespace App::Process {
+class CGroupRegistry;
+
+// limits in the units of CGroupConfig: memory in MB, cpu in cores, 0 means unlimited
+struct CGroupLimits {
+  float memory = 0;
+  float cpu = 0;
+
+  bool operator==(const CGroupLimits &other) const { return memory == other.memory && cpu == other.cpu; }
+  bool operator!=(const CGroupLimits &other) const { return !(*this == other); }
+};
+
+/**
+ * A cgroup in use. Held by the process groups and processes placed in it, the cgroup is removed
+ * when the last handle is released.
+ */
+class CGroupHandle {
+public:
+  CGroupHandle(CGroupRegistry *registry, std::string name) : registry_(registry), name_(std::move(name)) {}
+  ~CGroupHandle();
+
+  CGroupHandle(const CGroupHandle &) = delete;
+  CGroupHandle &operator=(const CGroupHandle &) = delete;
+
+  const std::string &name() const { return name_; }
+
+private:
+  CGroupRegistry *registry_;
+  std::string name_;
+};
+
+/**
+ * Owns one cgroup per path.
+ *
+ * The first Acquire creates the cgroup through OS::CGroup and writes its limits. Later ones hand
+ * out the same handle and only rewrite the control files whose limit actually changed, so
+ * restarting a single service or reloading a large config does not touch the cgroupfs for cgroups
+ * that stay the same. Must outlive every handle it gave out. Not thread safe, use from the loop
+ * thread.
+ */
+class CGroupRegistry {
+public:
+  static constexpr size_t kDefaultHistory = 60;
+
+  CGroupRegistry() = default;
+  ~CGroupRegistry() = default;
+
+  CGroupRegistry(const CGroupRegistry &) = delete;
+  CGroupRegistry &operator=(const CGroupRegistry &) = delete;
+
+  std::shared_ptr<CGroupHandle> Acquire(const std::string &name, const CGroupLimits &limits);
+
+  // limits currently written to the cgroup, false when it is not in use
+  bool Limits(const std::string &name, CGroupLimits *limits) const;
+  // rewrite the limits of a cgroup in use without creating it, false when it is not in use
+  bool Update(const std::string &name, const CGroupLimits &limits);
+  // freeze or thaw every task of a cgroup in use through cgroup.freeze, cgroup v2 only
+  bool Freeze(const std::string &name, bool frozen);
+
+  // read the stat files of every cgroup in use into its ring of recent samples
+  void Sample();
+  // number of samples kept per cgroup
+  void SetHistory(size_t history);
+  // the last sample, false when the cgroup was never sampled
+  bool Latest(const std::string &name, CGroupSample *sample) const;
+  // recent samples from the oldest to the newest
+  bool History(const std::string &name, std::vector<CGroupSample> *samples) const;
+
+  // cgroup.procs files of a cgroup: one on cgroup v2, one per controller (cpu, memory) on v1
+  static std::vector<std::string> ProcsFiles(const std::string &name);
+  // path of a control or stat file of a cgroup, controller selects the hierarchy on cgroup v1
+  static std::string ControlPath(const std::string &name, const char *controller, const char *file);
+  // directory of a cgroup in the hierarchy of controller
+  static std::string Directory(const std::string &name, const char *controller);
+  // cgroup v2 mounted at /sys/fs/cgroup
+  static bool Unified();
+
+  size_t Size() const { return entries_.size(); }
+  // control files written since start
+  uint64_t Writes() const { return writes_; }
+
+private:
+  friend class CGroupHandle;
+
+  struct Entry {
+    std::shared_ptr<OS::CGroup> cgroup;
+    std::weak_ptr<CGroupHandle> handle;
+    CGroupLimits applied;
+    std::unique_ptr<CGroupStats> stats;
+  };
+
+  // rewrite the control files of the limits that differ
+  void Apply(const std::string &name, Entry &entry, const CGroupLimits &limits);
+  bool WriteControl(const std::string &name, const char *controller, const char *file, const std::string &value);
+  // the last handle is gone, remove the cgroup
+  void Release(const std::string &name);
+
+  static std::string Relative(const std::string &name);
+
+private:
+  absl::flat_hash_map<std::string, Entry> entries_;
+  uint64_t writes_ = 0;
+  size_t history_ = kDefaultHistory;
+};
+} // namespace App::Process
@@ -0,0 +1,91 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace App::Process {
+// one reading of the stat files of a cgroup, fields a kernel does not provide stay 0
+struct CGroupSample {
+  // wall clock of the reading
+  int64_t timeMs = 0;
+  // cpu.stat (v1: cpuacct.usage and cpu.stat)
+  uint64_t cpuUsec = 0;
+  uint64_t cpuUserUsec = 0;
+  uint64_t cpuSystemUsec = 0;
+  uint64_t nrThrottled = 0;
+  uint64_t throttledUsec = 0;
+  // memory.current and memory.stat (v1: memory.usage_in_bytes and memory.stat)
+  uint64_t memoryBytes = 0;
+  uint64_t anonBytes = 0;
+  uint64_t fileBytes = 0;
+  uint64_t kernelBytes = 0;
+  // memory.events, v2 only
+  uint64_t memoryHigh = 0;
+  uint64_t memoryMax = 0;
+  uint64_t oom = 0;
+  uint64_t oomKill = 0;
+  // io.stat summed over all devices, v2 only
+  uint64_t ioReadBytes = 0;
+  uint64_t ioWriteBytes = 0;
+  uint64_t ioReads = 0;
+  uint64_t ioWrites = 0;
+  // pids.current
+  uint64_t pids = 0;
+};
+
+/**
+ * Reads the stat files of one cgroup into a ring of recent samples.
+ *
+ * The files are opened once and read with pread into a fixed buffer, the parsers work on
+ * string_views of that buffer, so a Sample makes one syscall per file and does not allocate once
+ * the ring exists. A file that cannot be opened (controller not enabled) is skipped from then on.
+ */
+class CGroupStats {
+public:
+  // name is the cgroup path relative to the hierarchy, unified selects the v2 file set
+  CGroupStats(std::string name, bool unified, size_t history);
+  ~CGroupStats();
+
+  CGroupStats(const CGroupStats &) = delete;
+  CGroupStats &operator=(const CGroupStats &) = delete;
+
+  // read all files, false when none of them could be read
+  bool Sample(int64_t nowMs);
+
+  // the ring is reallocated only when the size changes
+  void SetHistory(size_t history);
+
+  // false before the first successful Sample
+  bool Latest(CGroupSample *sample) const;
+  // samples from the oldest to the newest
+  void History(std::vector<CGroupSample> *samples) const;
+
+  // parsers, exposed for reuse; they only accumulate the keys they know
+  // "key value" lines as in cpu.stat, memory.stat and memory.events
+  static void ParseCpuStat(std::string_view data, bool unified, CGroupSample *sample);
+  static void ParseMemoryStat(std::string_view data, bool unified, CGroupSample *sample);
+  static void ParseMemoryEvents(std::string_view data, CGroupSample *sample);
+  // "major:minor key=value ..." lines of io.stat
+  static void ParseIoStat(std::string_view data, CGroupSample *sample);
+  // a file holding a single number, "max" reads as 0
+  static uint64_t ParseValue(std::string_view data);
+
+private:
+  enum File { kCpuStat, kCpuUsage, kMemoryCurrent, kMemoryStat, kMemoryEvents, kIoStat, kPidsCurrent, kFileCount };
+
+  // fd of a file, opened on first use, -1 when it is not available
+  int Open(File file);
+  std::string Path(File file) const;
+
+  std::string name_;
+  bool unified_;
+  std::array<int, kFileCount> fds_;
+  std::array<bool, kFileCount> tried_{};
+  std::vector<CGroupSample> ring_;
+  size_t head_ = 0;
+  size_t count_ = 0;
+};
+} // namespace App::Process
@@ -0,0 +1,66 @@
+#pragma once
+#include <event/event_loop.h>
+#include <functional>
+#include <memory>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace App::Process {
+class Process;
+
+/**
+ * Delivers child exits to the owning Process.
+ *
+ * Every spawned child is registered with a pidfd in the event loop, so an exit wakes up exactly
+ * the watcher of that child and is reaped with wait4(pid) together with its rusage. Kernels
+ * without pidfd_open (< 5.3) fall back to SIGCHLD. Those children are kept in a set of their
+ * own, and SIGCHLD only reaps that set, so children with a pidfd are never touched by it.
+ */
+class ChildWatcher : public std::enable_shared_from_this<ChildWatcher> {
+public:
+  using ExitCallback = std::function<void(Process &)>;
+
+  ChildWatcher(Core::Event::EventLoop *loop, ExitCallback callback);
+  ~ChildWatcher();
+
+  // start watching a running child, pidfd may be passed in when the spawner already has one
+  void watch(Process *process, int pidfd = -1);
+
+  // called when the Process is destroyed before its child was reaped, the child is still reaped
+  // so it does not stay a zombie, but nobody is told
+  void unwatch(pid_t pid);
+
+  // SIGCHLD handler, reaps the children which are not watched through a pidfd
+  void onSigChld();
+
+  size_t size() const { return children_.size(); }
+
+private:
+  struct Child {
+    ~Child();
+    ChildWatcher *watcher = nullptr;
+    Process *process = nullptr;
+    pid_t pid = 0;
+    int pidfd = -1;
+    event *ev = nullptr;
+  };
+
+  static void onPidfdReadable(evutil_socket_t fd, short events, void *param);
+  static int openPidfd(pid_t pid);
+
+  void reap(pid_t pid, int options);
+  void dispatch(pid_t pid, int status, const struct rusage &usage);
+  // the pidfd event could not be armed, leave the child to SIGCHLD
+  void fallBack(Child *child);
+
+private:
+  Core::Event::EventLoop *loop_;
+  ExitCallback callback_;
+  std::unordered_map<pid_t, std::unique_ptr<Child>> children_;
+  // children without a pidfd event, the only ones onSigChld reaps
+  std::unordered_set<pid_t> fallback_;
+  bool pidfd_supported_ = true;
+};
+} // namespace App::Process
@@ -0,0 +1,56 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace App::Process {
+/**
+ * A service command tokenized once at config load, ready to be passed to execve.
+ *
+ * Commands are split like a shell would split words (quotes and backslash escapes), but without
+ * any expansion, and the binary is resolved through PATH up front. Commands that need a shell
+ * (pipes, redirections, variables, globs...) or that are configured with shell: true are run
+ * through /bin/sh -c instead.
+ */
+class CommandLine {
+public:
+  /**
+   * @param command command from ProcessConfig
+   * @param shell run the command through /bin/sh -c
+   * @param error reason when the command can not be executed
+   * @return nullptr on error
+   */
+  static std::shared_ptr<const CommandLine> Parse(const std::string &command, bool shell, std::string *error);
+
+  CommandLine(const CommandLine &) = delete;
+  CommandLine &operator=(const CommandLine &) = delete;
+
+  // the original command, used to tell whether a reload changed it
+  const std::string &command() const { return command_; }
+  // shell: true in the config
+  bool shellRequested() const { return shellRequested_; }
+  // runs through /bin/sh -c, either requested or because the command needs it
+  bool shell() const { return shell_; }
+
+  const char *path() const { return path_.c_str(); }
+  char *const *argv() const { return argv_.data(); }
+  char *const *envp() const { return envp_.data(); }
+
+private:
+  CommandLine() = default;
+
+  static bool Tokenize(const std::string &command, std::vector<std::string> *args, bool *needShell);
+  static bool ResolveBinary(const std::string &name, std::string *path);
+  void Build(std::vector<std::string> args);
+
+private:
+  std::string command_;
+  bool shellRequested_ = false;
+  bool shell_ = false;
+  std::string path_;
+  std::vector<std::string> args_;
+  std::vector<char *> argv_;
+  std::vector<std::string> env_;
+  std::vector<char *> envp_;
+};
+} // namespace App::Process
@@ -17,13 +17,22 @@
 #include <utility>
 
 #include "component/api.h"
+#include "command_line.h"
+#include "config_cache.h"
+#include "config_diff.h"
+#include "file_store.h"
+#include "histogram.h"
 #include "component/timer_channel.h"
 #include "event/event_loop.h"
 #include "process.h"
+#include "timer_wheel.h"
 #include "watchermen/v1/manager.pb.h"
-#include <shared_mutex>
+#include <atomic>
+#include <mutex>
+#include <spdlog/async.h>
 #include <spdlog/common.h>
 #include <spdlog/spdlog.h>
+#include <unordered_map>
 
 namespace App::Process {
 struct IpInfo {
@@ -31,13 +40,6 @@ struct IpInfo {
   std::string ipv6;
 };
 
-/**
- * diffProcessPoolPair
- * 第一个参数是 新增的process
- * 第二个参数是 减少的process
- */
-using DiffProcessPoolPair = std::pair<std::map<std::string, ProcessConfig>, std::map<std::string, ProcessConfig>>;
-
 class TimerGuard;
 class Manager;
 
@@ -48,43 +50,120 @@ class Config : public Core::Component::BaseConfig {
 public:
   explicit Config(const std::string &);
 
-  void onUpdate() override { OnLogFileChanged(); };
-  void onCreate() override { OnLogFileChanged(); };
-  void onDelete() override { OnLogFileChanged(); };
+  void onUpdate() override { ScheduleReload(); };
+  void onCreate() override { ScheduleReload(); };
+  void onDelete() override { ScheduleReload(); };
 
   void OnServerConfig(const std::string &new_config);
   std::string Path() const { return path_; }
 
-  const ManagerConfig &GetConfig() { return config_; } // dangerous
+  /**
+   * 当前配置的只读快照，任意线程都可以调用，不会被重载阻塞
+   * 快照发布后不再修改，持有期间一直有效，重载会发布新的快照
+   */
+  std::shared_ptr<const ManagerConfig> Snapshot() const { return std::atomic_load(&snapshot_); }
 
-  void BindProcessManager(Manager *m) { m_ = m; }
-  IpInfo GetIpInfo() const;
+  // 快照的代数，每次发布加一，代数没变时可以继续用缓存的快照
+  uint64_t Generation() const { return generation_.load(std::memory_order_acquire); }
 
   /**
-   * 比较 配置service 变化
-   * @param oldService 旧的service
-   * @param newService 新的service
-   * @return
+   * 配置加载时解析好的启动命令，只能在事件循环线程使用
+   * @param name process_name
+   * @return 命令无法执行时返回 nullptr
    */
-  static DiffProcessPoolPair DiffProcessPool(const google::protobuf::RepeatedPtrField<::ProcessConfig> &oldService,
-                                             const google::protobuf::RepeatedPtrField<::ProcessConfig> &newService);
+  std::shared_ptr<const CommandLine> GetCommandLine(const std::string &name) const;
+
+  // 绑定后文件变化的重载在 manager 的时间轮上延迟执行，manager 析构前传 nullptr 解绑
+  void BindProcessManager(Manager *m);
+  IpInfo GetIpInfo() const;
+
+  // 重载统计，任意线程可读
+  uint64_t Reloads() const { return reloads_.load(std::memory_order_relaxed); }
+  uint64_t ReloadFailures() const { return reload_failures_.load(std::memory_order_relaxed); }
+  uint64_t FileEvents() const { return file_events_.load(std::memory_order_relaxed); }
+  // 重载耗时，包括启停进程
+  const LatencyHistogram &ReloadTime() const { return reload_time_; }
+  // 异步日志队列满时丢掉的日志条数，同步日志为 0
+  uint64_t LogDropped() const;
+  // 启动写日志的线程：log.async 为 true 时切换到异步日志，还有定期刷盘和压缩切割文件的线程
+  // 要在 daemon 模式 fork 之后调用
+  void StartAsyncLog();
+
+  // 两个 cgroup 配置只有 memory、cpu 不同，可以直接修改限额
+  static bool OnlyLimitsChanged(const CGroupConfig &oldConfig, const CGroupConfig &newConfig);
 
 private:
   static bool ReadConfig(const std::string &file, ManagerConfig &config);
+  // 优先从二进制缓存加载，缓存失效时解析 JSON 并重建缓存
+  bool LoadConfig(ManagerConfig &config) const;
   void OnLogFileChanged();
+  // 文件变化后等 reload.timeout 秒没有新的变化再重载，编辑器一次保存产生的多个事件只重载一次
+  void ScheduleReload();
   bool ReloadConfig(ManagerConfig &new_config);
   void SaveConfig();
+  // 解析 service 的启动命令，只在事件循环线程调用
+  void ParseCommands(const ManagerConfig &config);
+  // 发布新的快照
+  void Publish(std::shared_ptr<const ManagerConfig> config);
 
-  void UpdateLogPath(bool daemon, const std::string &path, const std::string &level);
+  void UpdateLogPath(bool daemon, const std::string &path, const std::string &level, const LogConfig &log);
+  // 按 log 设置刷盘的日志级别和定期刷盘的间隔
+  void UpdateLogFlush(const LogConfig &log);
+  // 用 sinks 重新创建异步日志
+  void ResetAsyncLogger(std::vector<spdlog::sink_ptr> sinks, const LogConfig &log);
 
 private:
-  mutable std::shared_mutex rw_lock_; // 保护config_
-  ManagerConfig config_{};
+  // 串行化重载，读者不加锁
+  std::mutex reload_lock_;
+  std::shared_ptr<const ManagerConfig> snapshot_;
+  std::atomic<uint64_t> generation_{0};
   std::string path_;
+  ConfigCache cache_;
+  // 自己写的配置文件，跳过没有变化的写入和写入引起的文件变化通知
+  FileStore files_;
+  std::unordered_map<std::string, std::shared_ptr<const CommandLine>> commands_;
+  // 当前 service 的指纹，重载时和新配置比较
+  FingerprintIndex fingerprints_;
   Manager *m_ = nullptr;
+  std::unique_ptr<Core::Event::WheelTimer> reload_timer_;
+  std::atomic<uint64_t> reloads_{0};
+  std::atomic<uint64_t> reload_failures_{0};
+  std::atomic<uint64_t> file_events_{0};
+  LatencyHistogram reload_time_;
   spdlog::sink_ptr stdout_sink_;
   spdlog::sink_ptr file_sink_;
   spdlog::sink_ptr syslog_sink_;
   std::shared_ptr<spdlog::logger> logger_;
+  // 异步日志的队列和写日志的线程，同步日志时为空
+  std::shared_ptr<spdlog::details::thread_pool> log_pool_;
+  // StartAsyncLog 之后才能启动日志的线程
+  bool log_started_ = false;
+};
+
+/**
+ * 缓存一份快照，只在代数变化时重新获取，适合频繁读取配置的地方
+ * 不是线程安全的，每个线程各自持有一个
+ */
+class ConfigView {
+public:
+  explicit ConfigView(const Config *config) : config_(config) {}
+
+  const ManagerConfig &operator*() { return *get(); }
+  const ManagerConfig *operator->() { return get().get(); }
+
+  const std::shared_ptr<const ManagerConfig> &get() {
+    auto generation = config_->Generation();
+    if (!snapshot_ || generation != generation_) {
+      // 先读代数再取快照，最多多取一次，不会用旧的快照
+      generation_ = generation;
+      snapshot_ = config_->Snapshot();
+    }
+    return snapshot_;
+  }
+
+private:
+  const Config *config_;
+  std::shared_ptr<const ManagerConfig> snapshot_;
+  uint64_t generation_ = 0;
 };
 } // namespace App::Process
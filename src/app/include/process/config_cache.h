@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "file_store.h"
+#include "watchermen/v1/manager.pb.h"
+
+namespace App::Process {
+/**
+ * Binary copy of the JSON config file, kept next to it as "<config>.cache".
+ *
+ * The cache records the inode, size, mtime and ctime of the JSON file it was made from and a
+ * crc32 of the serialized ManagerConfig. Load maps the file and parses it with ParseFromArray,
+ * which is much cheaper than JsonStringToMessage for configs with many services, and refuses the
+ * cache as soon as the JSON file was touched or the payload does not match its checksum. Callers
+ * then parse the JSON and Store a fresh cache.
+ */
+class ConfigCache {
+public:
+  explicit ConfigCache(std::string jsonPath) : jsonPath_(std::move(jsonPath)), path_(jsonPath_ + ".cache") {}
+
+  // false when there is no cache, it is stale or it is corrupt
+  bool Load(ManagerConfig *config) const;
+  // cache the config parsed from the JSON file identified by source, taken before it was read so a
+  // write during parsing makes the cache stale, replaces the old cache atomically
+  bool Store(const ManagerConfig &config, const FileIdentity &source) const;
+  // drop the cache, e.g. when the JSON file cannot be parsed
+  void Remove() const;
+
+  const std::string &path() const { return path_; }
+
+private:
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint64_t inode;
+    int64_t mtimeNs;
+    int64_t ctimeNs;
+    uint64_t jsonSize;
+    uint64_t payloadSize;
+    uint32_t crc;
+    uint32_t reserved;
+  };
+
+  std::string jsonPath_;
+  std::string path_;
+};
+} // namespace App::Process
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <absl/container/flat_hash_map.h>
+
+#include "watchermen/v1/manager.pb.h"
+
+namespace App::Process {
+/**
+ * Digests of one service. restart covers every field whose change needs the replicas to be
+ * restarted, limits covers the fields that can be applied to running replicas (cgroup memory and
+ * cpu).
+ */
+struct ServiceFingerprint {
+  uint64_t restart = 0;
+  uint64_t limits = 0;
+};
+
+// process_name => fingerprint of the services currently loaded
+using FingerprintIndex = absl::flat_hash_map<std::string, ServiceFingerprint>;
+
+/**
+ * What changed between two service lists. Configs point into the new service list and stay valid
+ * as long as its elements do.
+ */
+struct ServiceChangeSet {
+  std::vector<const ProcessConfig *> added;
+  std::vector<std::string> removed;
+  std::vector<const ProcessConfig *> restart;
+  // only cgroup limits changed
+  std::vector<const ProcessConfig *> hot;
+
+  bool empty() const { return added.empty() && removed.empty() && restart.empty() && hot.empty(); }
+};
+
+/**
+ * Fingerprint over the canonical serialization of a service. The cgroup is detached while the
+ * rest of the message is serialized and put back afterwards, so the service is only borrowed,
+ * never copied.
+ */
+ServiceFingerprint FingerprintService(ProcessConfig *service);
+
+// services without process_name or command are ignored, like everywhere else
+FingerprintIndex IndexServices(google::protobuf::RepeatedPtrField<ProcessConfig> *services);
+
+/**
+ * Compares the new services against the fingerprints of the loaded ones.
+ * @param loaded fingerprints of the services currently loaded
+ * @param services the new services
+ * @param index receives the fingerprints of the new services
+ */
+ServiceChangeSet DiffServices(const FingerprintIndex &loaded, google::protobuf::RepeatedPtrField<ProcessConfig> *services,
+                              FingerprintIndex *index);
+} // namespace App::Process
@@ -1,10 +1,12 @@
 #pragma once
-#include "component/timer_channel.h"
 #include "generated/grpc/agent/v1/controller.grpc.pb.h"
 #include "generated/grpc/agent/v1/controller.pb.h"
 #include "process/async_queue.h"
 #include "process/config.h"
+#include "process/histogram.h"
 #include "process/manager.h"
+#include "process/metrics.h"
+#include "process/timer_wheel.h"
 #include <grpcpp/alarm.h>
 #include <memory>
 #include <string>
@@ -45,6 +47,8 @@ private:
   void OnHealthCheck();
 
   void SetupHeartbeat();
+  // latency of the calls to the config center and the state of the async queue
+  std::vector<prometheus::MetricFamily> CollectMetrics() const;
 
 private:
   void Connect(bool keepalive);
@@ -60,12 +64,21 @@ private:
   std::string ipv6_;
   ConfigureCallback *callback_ = nullptr;
   App::Process::Config *config_listener_;
+  // snapshot used by the heartbeat, refreshed only after a reload
+  App::Process::ConfigView config_view_;
   App::Process::Manager *manager_;
   Core::Event::EventLoop *loop_;
-  std::unique_ptr<Core::Component::TimerChannel> heartbeat_timer_;
-  std::unique_ptr<Core::Component::TimerChannel> register_timer_;
-  std::unique_ptr<Core::Component::TimerChannel> health_check_timer_;
+  // the manager's wheel, or our own when running without a manager
+  std::unique_ptr<Core::Event::TimerWheel> own_timers_;
+  std::unique_ptr<Core::Event::WheelTimer> heartbeat_timer_;
+  std::unique_ptr<Core::Event::WheelTimer> register_timer_;
+  std::unique_ptr<Core::Event::WheelTimer> health_check_timer_;
   Core::Event::AsyncQueue async_queue_;
+  App::Process::LatencyHistogram register_latency_;
+  App::Process::LatencyHistogram get_config_latency_;
+  App::Process::LatencyHistogram unregister_latency_;
+  App::Process::LatencyHistogram heartbeat_latency_;
+  std::shared_ptr<prometheus::Collectable> metrics_;
   int heartbeat_fail_cnt_ = 0;
   int last_timeout_ = 0;
   uint64_t object_id_ = 0;
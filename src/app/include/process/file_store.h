@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include <absl/container/flat_hash_map.h>
+
+namespace App::Process {
+// what identifies one version of a file without reading it
+struct FileIdentity {
+  uint64_t inode = 0;
+  int64_t mtimeNs = 0;
+  // rsync -t, cp -p and touch -r can restore mtime, the kernel always sets ctime
+  int64_t ctimeNs = 0;
+  uint64_t size = 0;
+
+  bool operator==(const FileIdentity &other) const {
+    return inode == other.inode && mtimeNs == other.mtimeNs && ctimeNs == other.ctimeNs && size == other.size;
+  }
+  bool operator!=(const FileIdentity &other) const { return !(*this == other); }
+
+  // false when the file cannot be stat'ed
+  static bool Of(const std::string &path, FileIdentity *identity);
+};
+
+/**
+ * Persists files the crash-safe way and only when their content changes.
+ *
+ * Write puts the content in a temporary file in the same directory, fsyncs it, renames it over the
+ * target and fsyncs the directory, so after a crash the file holds either the old or the new
+ * content, never a truncated one. Content equal to what is on disk is not written at all. The
+ * store remembers the identity of every file it wrote, which lets the file watcher tell its own
+ * writes from edits made by someone else. Not thread safe, use from the loop thread.
+ */
+class FileStore {
+public:
+  enum class Result { kWritten, kUnchanged, kFailed };
+
+  Result Write(const std::string &path, const std::string &content);
+
+  // the file is still exactly what Write left there
+  bool WrittenBySelf(const std::string &path) const;
+
+private:
+  struct Record {
+    uint64_t hash;
+    FileIdentity identity;
+  };
+
+  static uint64_t Hash(const std::string &content);
+  static bool ReadAll(const std::string &path, std::string *content);
+  static bool SyncDirectory(const std::string &path);
+
+  absl::flat_hash_map<std::string, Record> records_;
+};
+} // namespace App::Process
@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace App::Process {
+/**
+ * Lock free latency histogram with power-of-two microsecond buckets (1us .. ~1s, plus +Inf).
+ * Record() may be called from any thread, readers get a relaxed snapshot.
+ */
+class LatencyHistogram {
+public:
+  static constexpr size_t kBuckets = 22;
+
+  void Record(std::chrono::nanoseconds latency) {
+    auto us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+    size_t index = 0;
+    while (index < kBuckets - 1 && us > UpperBoundMicros(index)) {
+      index++;
+    }
+    buckets_[index].fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(us, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // upper bound of bucket i, the last bucket is unbounded
+  static constexpr uint64_t UpperBoundMicros(size_t i) { return uint64_t{1} << i; }
+
+  uint64_t Bucket(size_t i) const { return buckets_[i].load(std::memory_order_relaxed); }
+  uint64_t SumMicros() const { return sum_us_.load(std::memory_order_relaxed); }
+  uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+
+private:
+  std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+  std::atomic<uint64_t> sum_us_{0};
+  std::atomic<uint64_t> count_{0};
+};
+} // namespace App::Process
@@ -0,0 +1,80 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <spdlog/details/file_helper.h>
+#include <spdlog/sinks/base_sink.h>
+
+namespace App::Process {
+/**
+ * Rotating file sink of the watchermen log.
+ *
+ * Unlike spdlog's rotating_file_sink, rotation costs the logging thread one rename and one open:
+ * the full file becomes path.<yyyymmdd-hhmmss-mmm>, and the background thread compresses it with
+ * gzip and deletes the oldest segments beyond backups or beyond total_bytes for all segments
+ * together. That thread runs with the lowest CPU and idle IO priority, so compressing never
+ * competes with the services watchermen supervises.
+ */
+class LogFileSink : public spdlog::sinks::base_sink<std::mutex> {
+public:
+  struct Options {
+    // rotate before the file grows beyond this
+    uint64_t maxBytes = 10 * 1024 * 1024;
+    // rotate a file that was opened this long ago, 0 never
+    std::chrono::seconds maxAge{0};
+    // rotated segments kept
+    uint32_t backups = 3;
+    // bytes of all rotated segments together, 0 unlimited
+    uint64_t totalBytes = 0;
+    bool compress = true;
+  };
+
+  LogFileSink(std::string path, const Options &options, const spdlog::file_event_handlers &handlers = {});
+  ~LogFileSink() override;
+
+  const std::string &filename() const { return path_; }
+
+  /**
+   * Start the background thread, rotated segments wait until then. Not in the constructor: the
+   * sink is created before the daemon forks, and a thread does not survive the fork.
+   */
+  void Start();
+
+  // takes effect with the next write, pruning with the next rotation
+  void SetOptions(const Options &options);
+
+protected:
+  void sink_it_(const spdlog::details::log_msg &msg) override;
+  void flush_() override;
+
+private:
+  void Rotate(std::chrono::system_clock::time_point now);
+  // path of the segment a file rotated at now is renamed to
+  std::string SegmentName(std::chrono::system_clock::time_point now) const;
+
+  // background thread
+  void Work();
+  bool Compress(const std::string &segment);
+  // compress the rotated segments and delete the ones beyond backups and total_bytes
+  void Prune(const Options &options);
+
+  std::string path_;
+  spdlog::details::file_helper file_;
+  uint64_t size_ = 0;
+  std::chrono::system_clock::time_point opened_;
+
+  // shared with the background thread
+  std::mutex work_lock_;
+  std::condition_variable work_cond_;
+  Options options_;
+  // a file was rotated, set at start to pick up segments left uncompressed by the last run
+  bool pending_ = true;
+  bool stop_ = false;
+  // not joinable until Start
+  std::thread worker_;
+};
+} // namespace App::Process
@@ -1,21 +1,70 @@
 #pragma once
+#include <chrono>
 #include <memory>
 #include <sys/wait.h>
+#include <vector>
+
+#include <absl/container/flat_hash_map.h>
 
 #include "config.h"
+#include "cgroup_registry.h"
+#include "child_watcher.h"
 #include "component/discovery/component.h"
+#include "histogram.h"
+#include "metrics.h"
+#include "oom_watcher.h"
+#include "output_log.h"
+#include "pressure_monitor.h"
 #include "process.h"
+#include "restart_policy.h"
+#include "spawner.h"
+#include "timer_wheel.h"
 #include "http/http_manager.h"
 #include "component/process/manager.h"
 
 namespace App {
 namespace Process {
 using namespace Core;
+
+/**
+ * 副本的重启状态，副本重新启动后保留
+ */
+struct ReplicaState {
+    explicit ReplicaState(const RestartPolicy& policy) : backoff(policy) {}
+    RestartBackoff backoff;
+    // 等待重启的定时器
+    Core::Event::TimerWheel::TimerId restartTimer = Core::Event::TimerWheel::kInvalidTimer;
+    // 被 OOM kill 的次数
+    uint32_t oomKills = 0;
+};
+
+/**
+ * 同一个 ProcessConfig 启动的 numprocs 个副本
+ */
+struct ProcessGroup {
+    ProcessConfig config;
+    // 父层级 cgroup，进程组自己的 cgroup 嵌套在它下面，在 cgroup 之前声明，释放在它之后
+    std::shared_ptr<CGroupHandle> parentCGroup;
+    std::shared_ptr<CGroupHandle> cgroup;
+    // 下标即副本编号
+    std::vector<std::unique_ptr<App::Process::Process>> replicas;
+    // 和 replicas 一一对应
+    std::vector<ReplicaState> states;
+    // 进程组自己 cgroup 的 OOM 事件，没有开启自己的 cgroup（在父层级里）时不统计
+    OomCounts oom;
+    // 自己 cgroup 里还没有对应到退出的副本的 oom_kill，以及最近一次的时间
+    uint64_t pendingOomKills = 0;
+    std::chrono::steady_clock::time_point lastOomKill;
+    // stdout_logfile 和 stderr_logfile，没有配置时为空
+    std::shared_ptr<OutputLog> stdoutLog;
+    std::shared_ptr<OutputLog> stderrLog;
+    // 同名的旧副本还在停止，全部退出后再启动
+    bool waitRetired = false;
+};
+
 class Manager :public Core::Component::Process::Manager {
 public:
-    explicit Manager(std::shared_ptr<App::Process::Config> config) : config_(std::move(config)) {
-
-    }
+    explicit Manager(std::shared_ptr<App::Process::Config> config);
 
 
     /**
@@ -37,11 +86,12 @@ public:
     }
 
     static void onRecycle(evutil_socket_t /*sig*/, short /*events*/, void *param) {
-        pid_t pid;
-        int stat;
-
-        while((pid = waitpid(-1, &stat, WNOHANG)) > 0){
-            printf("child %d terminated\n", pid);
+        if (!param) {
+            return;
+        }
+        auto manager = static_cast<Manager*>(param);
+        if (manager->children_) {
+            manager->children_->onSigChld();
         }
     }
 
@@ -61,9 +111,53 @@ public:
         return "manager";
     }
 
+    /**
+     * 启动进程
+     * @param name process_name 启动所有没有运行的副本，process_name:index 只启动一个副本
+     */
     void startProcess(const std::string& name);
 
-    ~Manager() {}
+    /**
+     * 停止进程
+     * @param name process_name 停止所有副本，process_name:index 只停止一个副本
+     */
+    void stopProcess(const std::string& name);
+
+    /**
+     * 遍历所有被管理的进程，包括已经删除但还没有退出的进程
+     */
+    template <typename Fn>
+    void forEachProcess(Fn&& fn) const {
+        for (auto& [name, group] : groups_) {
+            for (auto& process : group.replicas) {
+                if (process) {
+                    fn(*process);
+                }
+            }
+        }
+        for (auto& [ptr, process] : retired_) {
+            fn(*process);
+        }
+    }
+
+    /**
+     * 进程组的输出日志
+     * @param name process_name
+     * @param errorStream 为 true 时取标准错误，redirect_stderr 时和标准输出是同一个
+     * @return 没有配置输出日志时为空
+     */
+    std::shared_ptr<const OutputLog> findOutputLog(const std::string& name, bool errorStream) const;
+
+    // 事件循环上所有定时器共用的时间轮
+    Core::Event::TimerWheel* timers() const { return timers_.get(); }
+
+    // 启动进程耗时
+    const LatencyHistogram& spawnLatency() const { return spawnLatency_; }
+
+    // /metrics 输出的所有指标，其他模块可以注册自己的指标
+    const std::shared_ptr<MetricsRegistry>& metrics() const { return metrics_; }
+
+    ~Manager() { config_->BindProcessManager(nullptr); }
 private:
     // 启动进程池
     void startProcessPool();
@@ -72,13 +166,92 @@ private:
     // 安装http服务
     void setupHttpServer();
     // 停止部分进程
-    void destroyPartProcess(const std::map<std::string, ProcessConfig>& processConfMap);
+    void destroyPartProcess(const std::vector<std::string>& names);
     // 启动部分进程
-    void startPartProcess(const std::map<std::string, ProcessConfig>& processConfMap);
+    void startPartProcess(const std::vector<const ProcessConfig*>& processConfigs);
+    // 停止所有进程
+    void destroyAllProcess();
+    // 只修改 cgroup 限额，不重启进程
+    void updatePartProcess(const std::vector<const ProcessConfig*>& processConfigs);
+    // 父层级cgroup限额变化
+    void updateParentCGroup();
+    // 进程组使用的 cgroup 名字
+    std::string cgroupName(const ProcessConfig& processConfig) const;
+    // 停止并删除某个名字的进程组
+    void retireProcess(const std::string& name);
+    // 同名的旧副本是否还有没退出的
+    bool hasRetired(const std::string& name) const;
+    // 根据配置创建进程组并启动所有副本
+    void startGroup(const ProcessConfig& processConfig, const std::shared_ptr<CGroupHandle>& parentCGroup);
+    // 父层级cgroup，没有开启时为空
+    std::shared_ptr<CGroupHandle> createParentCGroup();
+    // 启动进程组的第 index 个副本并监听退出
+    void launch(ProcessGroup& group, uint32_t index);
+    // 打开输出日志，同一个文件只打开一次，退出中的旧进程和新进程写同一个 offset
+    std::shared_ptr<OutputLog> openOutputLog(const std::string& path, const OutputLogConfig& config);
+    /**
+     * 按名字查找进程组
+     * @param name process_name 或 process_name:index
+     * @param index 只指定了一个副本时为副本编号，否则为-1
+     */
+    ProcessGroup* findGroup(const std::string& name, int64_t* index);
+    // 子进程退出
+    void onProcessExit(App::Process::Process& process);
+    // 停止中，所有进程都退出后退出事件循环
+    void quitIfIdle();
+    // 按重启策略安排自己退出的进程重启
+    void scheduleRestart(ProcessGroup& group, uint32_t index);
+    // 取消等待中的重启
+    void cancelRestart(ReplicaState& state);
+    // cgroup 的 memory.events 计数增加
+    void onOom(const std::string& cgroup, const OomCounts& delta);
+    // 副本被 SIGKILL 杀掉且自己 cgroup 的 oom_kill 增加了时记为 OOM kill
+    bool takeOomKill(ProcessGroup& group, App::Process::Process& process);
+    // 进程组有自己的 cgroup，OOM 事件只对应到这样的进程组
+    static bool ownsCGroup(const ProcessGroup& group);
+    // 进程、cgroup 和配置重载的指标，只读内存中的数据
+    std::vector<prometheus::MetricFamily> collectMetrics() const;
+    // 定期读取 cgroup 用量，抓取指标时不读 cgroupfs
+    void sampleCGroups();
+    // 在父层级cgroup上按 ManagerConfig.pressure 重新设置压力触发器
+    void armParentPressure();
+    // 压力触发器触发，owner 为空表示父层级cgroup
+    void onPressure(const std::string& owner, const PressureConfig& config);
+    // 把进程组的 cpu 限额临时降到 cpu 核，hold 之后恢复配置的限额
+    void throttle(ProcessGroup& group, float cpu, std::chrono::seconds hold);
+    // 冻结进程组的 cgroup，hold 之后解冻
+    void freeze(ProcessGroup& group, std::chrono::seconds hold);
+    // 结束限流，restore 为 false 时不重写限额，由调用方写新的限额
+    void unthrottle(const std::string& name, bool restore);
+    // 解冻
+    void thaw(const std::string& name);
     friend class Config;
     std::shared_ptr<App::Process::Config> config_;
     std::shared_ptr<Core::Http::HttpManager> httpManager_;
     std::shared_ptr<Core::Component::Discovery::Component> discovery;
+    std::unique_ptr<Core::Event::TimerWheel> timers_;
+    std::unique_ptr<Core::Event::WheelTimer> sampleTimer_;
+    // 所有进程使用的 cgroup，需要比进程后析构
+    CGroupRegistry cgroups_;
+    // cgroup 上的 PSI 触发器
+    std::unique_ptr<PressureMonitor> pressure_;
+    // 监听 cgroup 的 OOM 事件
+    std::unique_ptr<OomWatcher> oom_;
+    // process_name => 恢复限额或者解冻的定时器
+    absl::flat_hash_map<std::string, Core::Event::TimerWheel::TimerId> throttled_;
+    absl::flat_hash_map<std::string, Core::Event::TimerWheel::TimerId> frozen_;
+    // 路径 => 输出日志，由进程组和进程持有
+    absl::flat_hash_map<std::string, std::weak_ptr<OutputLog>> outputLogs_;
+    std::shared_ptr<ChildWatcher> children_;
+    std::unique_ptr<Spawner> spawner_;
+    // process_name => 进程组
+    absl::flat_hash_map<std::string, ProcessGroup> groups_;
+    // 已经删除，等待退出的进程
+    absl::flat_hash_map<const App::Process::Process*, std::unique_ptr<App::Process::Process>> retired_;
+    LatencyHistogram spawnLatency_;
+    std::shared_ptr<MetricsRegistry> metrics_;
+    std::shared_ptr<prometheus::Collectable> collector_;
+    bool stopping_ = false;
 };
 }
 }
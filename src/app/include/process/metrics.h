@@ -0,0 +1,52 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <prometheus/collectable.h>
+#include <prometheus/metric_family.h>
+
+#include "histogram.h"
+
+namespace App::Process {
+using MetricLabels = std::vector<prometheus::ClientMetric::Label>;
+
+// helpers for Collect() implementations
+prometheus::MetricFamily MakeFamily(std::string name, std::string help, prometheus::MetricType type);
+// a counter, gauge or untyped sample depending on the type of the family
+void AddSample(prometheus::MetricFamily &family, double value, MetricLabels labels = {});
+// a LatencyHistogram with its buckets converted to seconds
+void AddHistogram(prometheus::MetricFamily &family, const LatencyHistogram &histogram, MetricLabels labels = {});
+
+// a source backed by a function, for components that already keep their own counters
+class FunctionCollectable : public prometheus::Collectable {
+public:
+  using Fn = std::function<std::vector<prometheus::MetricFamily>()>;
+
+  explicit FunctionCollectable(Fn fn) : fn_(std::move(fn)) {}
+
+  std::vector<prometheus::MetricFamily> Collect() const override { return fn_(); }
+
+private:
+  Fn fn_;
+};
+
+/**
+ * Everything exported on the metrics route.
+ *
+ * Sources only copy counters and snapshots they already keep, so a scrape costs a walk over
+ * in-memory state and never touches the cgroupfs or any other file. Sources are held weakly and
+ * dropped once they are gone. Use from the loop thread.
+ */
+class MetricsRegistry {
+public:
+  void Register(const std::shared_ptr<prometheus::Collectable> &source);
+
+  // all sources in the text exposition format
+  std::string Serialize();
+
+private:
+  std::vector<std::weak_ptr<prometheus::Collectable>> sources_;
+};
+} // namespace App::Process
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+#include <functional>
+
+#include "http/http_request.h"
+#include "http/http_response.h"
+#include "http/http_manager.h"
+#include "metrics.h"
+
+namespace App {
+namespace Process {
+using namespace std::placeholders;
+
+/**
+ * prometheus 指标接口，只序列化各个模块已经采集好的数据
+ */
+class MetricsHttpHelper :public Core::Noncopyable, public std::enable_shared_from_this<MetricsHttpHelper>{
+public:
+    explicit MetricsHttpHelper(const std::shared_ptr<Core::Http::HttpManager>& manager,
+                               const std::shared_ptr<MetricsRegistry>& registry, const std::string& path)
+            :manager_(manager), registry_(registry) {
+        if (!path.empty()) {
+            this->path = path;
+        }
+    };
+
+    ~MetricsHttpHelper() {};
+
+    void bind();
+
+    void handle(Core::Http::HttpRequest &request, Core::Http::HttpResponse &response);
+
+private:
+    std::string path = "/metrics";
+    std::shared_ptr<Core::Http::HttpManager> manager_;
+    std::shared_ptr<MetricsRegistry> registry_;
+};
+}
+}
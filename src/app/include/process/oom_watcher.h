@@ -0,0 +1,77 @@
+#pragma once
+#include <event/event_loop.h>
+#include <event/event_smart_ptr.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <absl/container/flat_hash_map.h>
+
+namespace App::Process {
+// the oom and oom_kill counters of memory.events
+struct OomCounts {
+  uint64_t oom = 0;
+  uint64_t oomKill = 0;
+};
+
+/**
+ * Reports OOM events of cgroups as they happen.
+ *
+ * The kernel sends an inotify IN_MODIFY for memory.events whenever one of its counters moves, so
+ * one inotify fd in the event loop covers every watched cgroup. On a notification the file is
+ * read again (one pread on an fd kept open) and the increase of oom and oom_kill since the last
+ * read is handed to the callback. Counters that were already set when the watch started are not
+ * reported, a reused cgroup does not replay old OOMs.
+ *
+ * memory.events exists on cgroup v2 only, on v1 Watch fails. Not thread safe, use from the loop
+ * thread.
+ */
+class OomWatcher {
+  static void EventFn(evutil_socket_t, short, void *handler);
+
+public:
+  using Callback = std::function<void(const std::string &cgroup, const OomCounts &delta)>;
+
+  OomWatcher(Core::Event::EventLoop *loop, Callback callback);
+  ~OomWatcher();
+
+  OomWatcher(const OomWatcher &) = delete;
+  OomWatcher &operator=(const OomWatcher &) = delete;
+
+  // counted, a cgroup shared by several services is watched once
+  bool Watch(const std::string &cgroup);
+  void Unwatch(const std::string &cgroup);
+
+  // read memory.events now instead of waiting for the notification, the callback runs before it
+  // returns when the counters moved
+  void Check(const std::string &cgroup);
+
+  size_t Size() const { return entries_.size(); }
+  // inotify events received
+  uint64_t Notifications() const { return notifications_; }
+
+private:
+  struct Entry {
+    ~Entry();
+    std::string cgroup;
+    int fd = -1;
+    int wd = -1;
+    size_t refs = 0;
+    OomCounts last;
+  };
+
+  void OnReadable();
+  // false when the file could not be read
+  static bool Read(const Entry &entry, OomCounts *counts);
+  void Update(Entry &entry);
+
+  Core::Event::EventLoop *loop_;
+  Callback callback_;
+  int inotify_fd_ = -1;
+  Core::Event::EventPtr event_;
+  absl::flat_hash_map<std::string, std::unique_ptr<Entry>> entries_;
+  absl::flat_hash_map<int, Entry *> wds_;
+  uint64_t notifications_ = 0;
+};
+} // namespace App::Process
@@ -0,0 +1,116 @@
+#pragma once
+#include <event/event_loop.h>
+#include <event/event_smart_ptr.h>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+#include "tail_buffer.h"
+#include "watchermen/v1/manager.pb.h"
+
+namespace App::Process {
+/**
+ * A rotating log file for the output of one service, shared by its replicas.
+ *
+ * Output is moved from the pipes into the file with splice(), so it never passes through a
+ * userspace buffer. splice does not accept O_APPEND files, the file is written at an offset kept
+ * here instead. The file is rotated to path.1 .. path.<backups> when it would grow past max_bytes
+ * or got older than rotate_secs. A token bucket caps the bytes per second, output beyond it is
+ * spliced into /dev/null and counted, so a chatty service never blocks on a full pipe and cannot
+ * saturate the disk. Before that the bytes are tee()d into a second pipe and read into a
+ * TailBuffer, the tail holds the output dropped by the rate limit too. Use from the loop thread.
+ */
+class OutputLog {
+public:
+  static constexpr uint64_t kDefaultMaxBytes = 50 * 1024 * 1024;
+  static constexpr uint32_t kDefaultBackups = 10;
+
+  OutputLog(std::string path, const OutputLogConfig &config);
+  ~OutputLog();
+
+  OutputLog(const OutputLog &) = delete;
+  OutputLog &operator=(const OutputLog &) = delete;
+
+  // rotation, rate limit and tail size of a reloaded config, the file stays open
+  void SetConfig(const OutputLogConfig &config);
+
+  /**
+   * Move what is buffered in a pipe into the file.
+   * @param pipe read end of a pipe, non blocking
+   * @return bytes taken from the pipe, 0 at end of file, -1 with errno set (EAGAIN when empty)
+   */
+  ssize_t Drain(int pipe);
+
+  const std::string &path() const { return path_; }
+  // bytes written to the file since start
+  uint64_t written() const { return written_; }
+  // bytes thrown away by the rate limit or a failed write
+  uint64_t dropped() const { return dropped_; }
+  uint64_t rotations() const { return rotations_; }
+  // stays empty when the tail pipe could not be created
+  const TailBuffer *tail() const { return tail_.get(); }
+
+private:
+  bool Open();
+  void Rotate();
+  // bytes of n the rate limit lets through now
+  size_t Take(size_t n);
+  // drop n bytes of the pipe
+  ssize_t Discard(int pipe, size_t n);
+  // copy up to n bytes of the pipe into the tail without taking them, returns how many
+  size_t Tee(int pipe, size_t n);
+  static int NullFd();
+
+  std::string path_;
+  uint64_t maxBytes_ = kDefaultMaxBytes;
+  uint32_t backups_ = kDefaultBackups;
+  std::chrono::seconds rotateAge_{0};
+  // bytes per second, 0 is unlimited
+  uint64_t rate_ = 0;
+  double tokens_ = 0;
+  std::chrono::steady_clock::time_point refilled_;
+  int fd_ = -1;
+  off64_t offset_ = 0;
+  time_t opened_ = 0;
+  // last open attempt, and whether it failed
+  time_t opening_ = 0;
+  bool openFailed_ = false;
+  uint64_t written_ = 0;
+  uint64_t dropped_ = 0;
+  uint64_t rotations_ = 0;
+  std::unique_ptr<TailBuffer> tail_;
+  // tee() only copies between pipes, the tail is read from this one
+  int tailPipe_[2] = {-1, -1};
+};
+
+/**
+ * Read end of the stdout or stderr pipe of one replica, drained into an OutputLog whenever it
+ * becomes readable. Owned by the Process, so output of whatever the replica forked is still taken
+ * after it exited, until the Process is replaced by a restart.
+ */
+class OutputCapture {
+  static void EventFn(evutil_socket_t, short, void *handler);
+
+public:
+  // pipe must be non blocking, it is owned from now on
+  OutputCapture(Core::Event::EventLoop *loop, int pipe, std::shared_ptr<OutputLog> log);
+  // takes what is still in the pipe before closing it, at most one pipe size
+  ~OutputCapture();
+
+  OutputCapture(const OutputCapture &) = delete;
+  OutputCapture &operator=(const OutputCapture &) = delete;
+
+  bool closed() const { return pipe_ == -1; }
+
+private:
+  void OnReadable();
+  void Close();
+
+  int pipe_;
+  std::shared_ptr<OutputLog> log_;
+  Core::Event::EventPtr event_;
+};
+} // namespace App::Process
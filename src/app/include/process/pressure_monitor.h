@@ -0,0 +1,98 @@
+#pragma once
+#include <event/event_loop.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <absl/container/flat_hash_map.h>
+
+#include "process/async_queue.h"
+#include "watchermen/v1/manager.pb.h"
+
+namespace App::Process {
+/**
+ * PSI triggers on the cgroups of the services.
+ *
+ * A trigger is a "some|full <stall> <window>" line written to <cgroup>/{cpu,memory,io}.pressure,
+ * the kernel then raises POLLPRI on that fd whenever the stall time within the window crosses the
+ * threshold, at most once per window. The event is consumed by whoever polls the fd first, so the
+ * fds can neither go into libevent (they always report readable) nor into an epoll fd nested in
+ * it (the outer poll eats the event). A waiter thread blocks in epoll_wait on all trigger fds and
+ * hands each event to the loop thread through the control lane of an AsyncQueue, so a reaction
+ * runs within the same loop iteration and the thread costs nothing while the system is calm.
+ *
+ * Needs cgroup v2 and a kernel with PSI (>= 5.2). Watch, Unwatch and the callback run on the loop
+ * thread.
+ */
+class PressureMonitor {
+public:
+  // owner is the name given to Watch
+  using Callback = std::function<void(const std::string &owner, const PressureConfig &config)>;
+
+  // bounds of the window accepted by the kernel
+  static constexpr uint32_t kMinWindowMs = 500;
+  static constexpr uint32_t kMaxWindowMs = 10000;
+  // without CAP_SYS_RESOURCE the window has to be a multiple of this
+  static constexpr uint32_t kUnprivilegedWindowMs = 2000;
+
+  PressureMonitor(Core::Event::EventLoop *loop, Callback callback);
+  ~PressureMonitor();
+
+  PressureMonitor(const PressureMonitor &) = delete;
+  PressureMonitor &operator=(const PressureMonitor &) = delete;
+
+  // arm a trigger on cgroup for owner, false when the kernel refused it
+  bool Watch(const std::string &owner, const std::string &cgroup, const PressureConfig &config);
+
+  // drop every trigger of owner, events already on the way are discarded
+  void Unwatch(const std::string &owner);
+
+  // calls fn(owner, cgroup, config, events) for every armed trigger
+  template <typename Fn> void ForEach(Fn &&fn) const {
+    for (auto &[owner, triggers] : triggers_) {
+      for (auto &trigger : triggers) {
+        fn(owner, trigger->cgroup, trigger->config, trigger->events);
+      }
+    }
+  }
+
+  // the "<resource>.pressure" file of a cgroup
+  static std::string PressurePath(const std::string &cgroup, PressureConfig::Resource resource);
+
+  // the line written to arm a config, window and stall clamped to what the kernel accepts,
+  // unprivileged rounds the window up to kUnprivilegedWindowMs
+  static std::string TriggerLine(const PressureConfig &config, bool unprivileged = false);
+
+private:
+  struct Trigger {
+    ~Trigger();
+    uint64_t id = 0;
+    std::string owner;
+    std::string cgroup;
+    PressureConfig config;
+    int fd = -1;
+    uint64_t events = 0;
+  };
+
+  // waiter thread
+  void Wait();
+  // loop thread, error is set when the cgroup was removed under the trigger
+  void Dispatch(uint64_t id, bool error);
+  void Remove(uint64_t id);
+
+  Callback callback_;
+  Core::Event::AsyncQueue queue_;
+  int epoll_fd_ = -1;
+  // wakes the waiter up on shutdown
+  int wake_fd_ = -1;
+  // started with the first trigger
+  std::thread waiter_;
+  // 0 is the id of wake_fd_
+  uint64_t next_id_ = 1;
+  absl::flat_hash_map<std::string, std::vector<std::unique_ptr<Trigger>>> triggers_;
+  absl::flat_hash_map<uint64_t, Trigger *> ids_;
+};
+} // namespace App::Process
@@ -12,34 +12,228 @@
 //
 
 #pragma once
-#include "os/unix_cgroup.h"
-#include "component/process/process.h"
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+#include "cgroup_registry.h"
+#include "command_line.h"
+#include "event/event_loop.h"
+#include "output_log.h"
+#include "timer_wheel.h"
 
 namespace App {
 namespace Process {
-class Process :public Core::Component::Process::Process {
+class ChildWatcher;
+class Spawner;
+
+// 取值和 libcore 的 Core::Component::Process::ProcessStatus 相同，/process/list 的 status 不变，
+// 新的状态加在最后
+enum class ProcessStatus {
+    UNKNOWN = 0,
+    RUN = 1,
+    RUNNING = 2,
+    STOPPED = 3,
+    STOPPING = 4,
+    RELOAD = 5,
+    RELOADING = 6,
+    EXITED = 7,
+    DELETING = 8,
+    DELETED = 9,
+    // 退出后等待重启
+    BACKOFF = 10,
+    // 短时间内重启次数过多，不再重启
+    FATAL = 11,
+};
+
+const char* processStatusName(ProcessStatus status);
+
+/**
+ * 被管理的子进程，由 Spawner 启动，退出由 ChildWatcher 投递
+ */
+class Process {
 public:
-    explicit Process(const std::string &command, const std::shared_ptr<Core::Event::EventLoop>& loop)
-    : Core::Component::Process::Process(command, loop) {
+    Process(const std::string &command, const std::shared_ptr<Core::Event::EventLoop>& loop,
+            Core::Event::TimerWheel* timers)
+    : command_(command), loop_(loop), timers_(timers) {
+        generation_++;
+    }
 
+    ~Process();
+
+    Process(const Process&) = delete;
+    Process& operator=(const Process&) = delete;
+
+    /**
+     * 设置进程名字
+     * @param group ProcessConfig 的 process_name
+     * @param index 副本编号
+     * @param numprocs 副本数，大于1时进程名字为 group:index
+     */
+    void setName(const std::string& group, uint32_t index = 0, uint32_t numprocs = 1) {
+        group_ = group;
+        index_ = index;
+        name_ = numprocs > 1 ? group + ":" + std::to_string(index) : group;
+        generation_++;
     }
+    const std::string& name() const { return name_; }
+    const std::string& group() const { return group_; }
+    uint32_t index() const { return index_; }
+    const std::string& command() const { return command_; }
 
-    void onCreate() override {
+    // 配置加载时解析好的命令，没有设置时启动前再解析
+    void setCommandLine(std::shared_ptr<const CommandLine> commandLine) { commandLine_ = std::move(commandLine); }
 
-    };
-    void onStart() override {
+    /**
+     * 设置进程所在的cgroup，启动时子进程会把自己写进这个cgroup
+     * @param cgroup cgroup，进程销毁前不会被删除
+     */
+    void setCGroup(const std::shared_ptr<CGroupHandle>& cgroup) { cgroup_ = cgroup; }
+
+    /**
+     * 设置标准输出和标准错误写入的日志，启动时通过管道接到子进程
+     * @param stdoutLog 标准输出的日志，为空时继承 watchermen 的
+     * @param stderrLog 标准错误的日志，为空时继承 watchermen 的
+     * @param redirectStderr 标准错误写到标准输出，此时忽略 stderrLog
+     */
+    void setOutput(std::shared_ptr<OutputLog> stdoutLog, std::shared_ptr<OutputLog> stderrLog, bool redirectStderr) {
+        stdoutLog_ = std::move(stdoutLog);
+        stderrLog_ = std::move(stderrLog);
+        redirectStderr_ = redirectStderr;
+    }
+
+    /**
+     * 启动子进程
+     * @param spawner spawner
+     * @param pidfd 子进程的pidfd，不支持时为-1
+     * @return 是否启动成功
+     */
+    bool execute(Spawner& spawner, int* pidfd);
+
+    /**
+     * 设置停止方式
+     * @param sig 停止信号
+     * @param wait 发出停止信号后等待多久，超时后发送 SIGKILL
+     * @param asGroup 是否给整个进程组发信号
+     */
+    void setStopPolicy(int sig, std::chrono::seconds wait, bool asGroup) {
+        stopSignal_ = sig;
+        stopWait_ = wait;
+        stopAsGroup_ = asGroup;
+    }
 
-    };
-    void onStop() override {
+    /**
+     * 给子进程发送停止信号，不等待退出，超时后由事件循环发送 SIGKILL
+     */
+    void stop();
 
-    };
-    void onDestroy() override {
+    /**
+     * 子进程退出，由 ChildWatcher 回调
+     * @param status wait4 返回的状态
+     * @param usage 子进程的资源使用
+     */
+    void onExit(int status, const struct rusage &usage);
 
-    };
+    void attachWatcher(std::weak_ptr<ChildWatcher> watcher) { watcher_ = std::move(watcher); }
+    void detachWatcher() { watcher_.reset(); }
 
-    ~Process() {}
+    // 等待 delay 后重启
+    void markBackoff(std::chrono::milliseconds delay) {
+        status_ = ProcessStatus::BACKOFF;
+        backoff_ = delay;
+        generation_++;
+    }
+    void markFatal() {
+        status_ = ProcessStatus::FATAL;
+        generation_++;
+    }
+
+    // 自动重启的次数
+    void setRestarts(uint32_t restarts) {
+        restarts_ = restarts;
+        generation_++;
+    }
+    uint32_t restarts() const { return restarts_; }
+    std::chrono::milliseconds backoff() const { return backoff_; }
+
+    // 被 OOM kill 的次数，副本重新启动后保留
+    void setOomKills(uint32_t oomKills) {
+        oomKills_ = oomKills;
+        generation_++;
+    }
+    uint32_t oomKills() const { return oomKills_; }
+    // 上次退出是被 cgroup 的 OOM killer 杀掉的
+    void markOomKilled() {
+        oomKilled_ = true;
+        oomKills_++;
+        generation_++;
+    }
+    bool oomKilled() const { return oomKilled_; }
+
+    // 进程被删除，退出后不再保留
+    void markRemoved() { removed_ = true; }
+    bool removed() const { return removed_; }
+
+    pid_t getPid() const { return pid_; }
+    ProcessStatus getStatus() const { return status_; }
+    time_t getStartTime() const { return startTime_; }
+    bool running() const { return status_ == ProcessStatus::RUNNING || status_ == ProcessStatus::STOPPING; }
+
+    /**
+     * 进程列表的版本号，任何一个进程创建、销毁，或者名字、pid、状态、重启次数变化时加一
+     * 版本号没变时 /process/list 的内容不变，只在事件循环线程修改
+     */
+    static uint64_t generation() { return generation_; }
+
+    // wait4 返回的原始状态
+    int exitStatus() const { return exitStatus_; }
+    // 退出时的资源使用
+    const struct rusage &usage() const { return usage_; }
+
+private:
+    // 给进程或者进程组发信号
+    void signal(int sig);
+    void onStopTimeout();
+    // 给 log 建一个管道，读端交给 OutputCapture，写端给子进程
+    bool openOutput(const std::shared_ptr<OutputLog>& log, int fds[2]);
 
 private:
+    std::string name_;
+    std::string group_;
+    uint32_t index_ = 0;
+    std::string command_;
+    std::shared_ptr<const CommandLine> commandLine_;
+    std::shared_ptr<Core::Event::EventLoop> loop_;
+    Core::Event::TimerWheel* timers_;
+    std::shared_ptr<CGroupHandle> cgroup_;
+    std::shared_ptr<OutputLog> stdoutLog_;
+    std::shared_ptr<OutputLog> stderrLog_;
+    bool redirectStderr_ = false;
+    // 进程退出后继续接收它 fork 出来的进程的输出，直到 Process 销毁
+    std::unique_ptr<OutputCapture> stdoutCapture_;
+    std::unique_ptr<OutputCapture> stderrCapture_;
+    std::weak_ptr<ChildWatcher> watcher_;
+    pid_t pid_ = 0;
+    ProcessStatus status_ = ProcessStatus::UNKNOWN;
+    time_t startTime_ = 0;
+    bool removed_ = false;
+    int exitStatus_ = 0;
+    struct rusage usage_ {};
+    int stopSignal_ = SIGTERM;
+    std::chrono::seconds stopWait_{10};
+    bool stopAsGroup_ = false;
+    uint32_t restarts_ = 0;
+    std::chrono::milliseconds backoff_{0};
+    uint32_t oomKills_ = 0;
+    bool oomKilled_ = false;
+    // 停止超时定时器
+    Core::Event::TimerWheel::TimerId killTimer_ = Core::Event::TimerWheel::kInvalidTimer;
+    static inline uint64_t generation_ = 0;
 };
 }
 }
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <functional>
+#include <string>
 
 #include "http/http_request.h"
 #include "http/http_response.h"
@@ -17,18 +19,48 @@ public:
     explicit ProcessHttpHelper(const std::shared_ptr<Core::Http::HttpManager>& manager,
                                Manager* processManager)
             :manager_(manager), processManager(processManager) {
+        initStatus();
     };
 
     ~ProcessHttpHelper() {};
 
     void bind();
 
+    /**
+     * 进程列表，进程的版本号没变时直接返回上次序列化的内容
+     * 请求的 If-None-Match 和 ETag 相同时返回 304
+     */
     void handle(Core::Http::HttpRequest &request, Core::Http::HttpResponse &response);
 
+    // 状态名字到状态值的对照表，内容不会变化
+    void handleStatus(Core::Http::HttpRequest &request, Core::Http::HttpResponse &response);
+
+    /**
+     * 进程组最近的输出，从内存中读取
+     * 参数 name 为 process_name，stream 为 stdout（默认）或 stderr，
+     * since 为 unix 时间戳，只返回之后的输出，tail 为最多返回的行数
+     */
+    void handleLogs(Core::Http::HttpRequest &request, Core::Http::HttpResponse &response);
+
 private:
     std::string path = "/process/list";
+    std::string logsPath = "/process/logs";
+    std::string statusPath = "/process/status";
     const std::shared_ptr<Core::Http::HttpManager>& manager_;
     Manager* processManager = nullptr;
+
+    void initStatus();
+    // 进程列表变化后重新序列化到 listBody
+    void refreshList();
+    // 序列化后的进程列表，重复使用同一块内存
+    std::string listBody;
+    std::string listETag;
+    uint64_t listGeneration = 0;
+    bool listCached = false;
+    // 区分 watchermen 的每次启动，重启后版本号重新计数，ETag 不能相同
+    std::string etagPrefix;
+    std::string statusBody;
+    std::string statusETag;
 };
 }
 }
@@ -0,0 +1,69 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <random>
+
+#include "watchermen/v1/manager.pb.h"
+
+namespace App::Process {
+/**
+ * Decides whether and when a replica that exited on its own is started again.
+ *
+ * The delay grows exponentially from initial_backoff_ms up to max_backoff_ms, with jitter so that
+ * replicas crashing together do not restart in lockstep. More than max_restarts restarts within
+ * window_secs puts the replica into FATAL, where it stays until it is started by hand. A replica
+ * that stayed up for a whole window is considered healthy again and starts over from the initial
+ * backoff.
+ *
+ * An exit by the OOM killer waits at least oom_backoff_ms, doubled for every OOM kill in a row,
+ * since starting again right away usually runs into the same limit. More than max_oom_restarts
+ * OOM kills in a row put the replica into FATAL as well.
+ */
+class RestartBackoff {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit RestartBackoff(const RestartPolicy &policy);
+
+  enum class Decision { kRestart, kStop, kFatal };
+
+  /**
+   * @param status wait4 status of the exit
+   * @param oomKilled the exit was an OOM kill of the cgroup
+   * @param uptime how long the replica ran
+   * @param now time of the exit
+   * @param delay receives the delay before the restart when kRestart is returned
+   */
+  Decision OnExit(int status, bool oomKilled, Clock::duration uptime, Clock::time_point now,
+                  std::chrono::milliseconds *delay);
+
+  // started by hand, forget the crash history
+  void Reset();
+
+  // restarts since the replica was last started by hand
+  uint32_t restarts() const { return restarts_; }
+  // the last scheduled delay
+  std::chrono::milliseconds backoff() const { return backoff_; }
+  bool fatal() const { return fatal_; }
+  // OOM kills in a row
+  uint32_t oomStreak() const { return oomStreak_; }
+
+private:
+  RestartPolicy::Mode mode_;
+  uint32_t maxRestarts_;
+  Clock::duration window_;
+  std::chrono::milliseconds initialBackoff_;
+  std::chrono::milliseconds maxBackoff_;
+  std::chrono::milliseconds oomBackoff_;
+  uint32_t maxOomRestarts_;
+
+  uint32_t restarts_ = 0;
+  uint32_t attempt_ = 0;
+  std::chrono::milliseconds backoff_{0};
+  bool fatal_ = false;
+  uint32_t oomStreak_ = 0;
+  // restart times inside the window
+  std::deque<Clock::time_point> recent_;
+};
+} // namespace App::Process
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <sys/types.h>
+#include <vector>
+
+namespace App::Process {
+/**
+ * Everything the child needs between clone and execve. It is prepared by the parent, the child
+ * only reads it and must not allocate.
+ */
+struct SpawnRequest {
+  const char *path = nullptr;
+  char *const *argv = nullptr;
+  char *const *envp = nullptr;
+  // cgroup.procs files the child writes itself into before execve
+  std::vector<int> cgroupProcsFds;
+  // become stdout and stderr of the child, -1 keeps the ones of the supervisor
+  int stdoutFd = -1;
+  int stderrFd = -1;
+  // stderr goes wherever stdout goes
+  bool redirectStderr = false;
+};
+
+/**
+ * vfork-style process spawner.
+ *
+ * The child is created with clone(CLONE_VM | CLONE_VFORK), so it shares the supervisor address
+ * space until execve and spawning does not copy page tables proportional to the supervisor RSS.
+ * Before execve the child moves itself into its cgroups, so the service runs inside them from its
+ * first instruction, and into a new process group, so the whole service can be signaled at once.
+ * A pidfd is returned through CLONE_PIDFD when the kernel supports it.
+ *
+ * Not thread safe: the child stack is reused, spawn only from the event loop thread.
+ */
+class Spawner {
+public:
+  Spawner();
+  ~Spawner();
+
+  Spawner(const Spawner &) = delete;
+  Spawner &operator=(const Spawner &) = delete;
+
+  /**
+   * @param request what to execute
+   * @param pidfd receives a pidfd of the child, or -1 when not supported
+   * @return pid of the child, or -errno when clone or execve failed
+   */
+  pid_t spawn(const SpawnRequest &request, int *pidfd);
+
+private:
+  static int childMain(void *arg);
+  // make fd the target fd of the child, async signal safe
+  static bool redirect(int fd, int target);
+
+private:
+  void *stack_ = nullptr;
+  size_t stackSize_ = 0;
+  bool pidfdSupported_ = true;
+};
+} // namespace App::Process
@@ -0,0 +1,67 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+namespace App::Process {
+/**
+ * The most recent output of a service, kept in memory so the tail can be served without reading
+ * the log file.
+ *
+ * A byte ring of fixed capacity. Bytes are addressed by their position in the stream, head() is
+ * the position after the last byte written. Positions are also recorded once per second, for
+ * reading what was written since a point in time. Not thread safe: the writer (OutputLog) and the
+ * readers (the http handlers) both run on the loop thread, and OutputLog replaces the whole buffer
+ * when the capacity changes.
+ */
+class TailBuffer {
+public:
+  static constexpr size_t kDefaultCapacity = 64 * 1024;
+  static constexpr size_t kMaxCapacity = 4 * 1024 * 1024;
+
+  // capacity is clamped to kMaxCapacity, 0 takes the default
+  explicit TailBuffer(size_t capacity);
+
+  TailBuffer(const TailBuffer &) = delete;
+  TailBuffer &operator=(const TailBuffer &) = delete;
+
+  /**
+   * Read up to n bytes from fd into the ring.
+   * @return bytes read, -1 with errno set
+   */
+  ssize_t Fill(int fd, size_t n);
+  void Append(const char *data, size_t n);
+
+  /**
+   * Copy what is still held from position from on.
+   * @return position of the first byte copied, later than from when it was overwritten already
+   */
+  uint64_t Read(uint64_t from, std::string *out) const;
+
+  // position of the first byte written at or after t, head() when nothing was
+  uint64_t Since(time_t t) const;
+
+  uint64_t head() const { return head_; }
+  size_t capacity() const { return capacity_; }
+
+private:
+  // position and time a write started, at most one per second
+  struct Mark {
+    uint64_t position = 0;
+    time_t time = 0;
+  };
+  static constexpr size_t kMarks = 256;
+
+  void Advance(uint64_t head);
+
+  size_t capacity_;
+  std::unique_ptr<char[]> data_;
+  uint64_t head_ = 0;
+  std::array<Mark, kMarks> marks_;
+  size_t nextMark_ = 0;
+  time_t lastMark_ = 0;
+};
+} // namespace App::Process
@@ -0,0 +1,128 @@
+#pragma once
+#include <event/event_loop.h>
+#include <event/event_smart_ptr.h>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "process/async_queue.h"
+
+namespace Core::Event {
+/**
+ * Hierarchical timer wheel driven by a single libevent timer.
+ *
+ * Timers live in a slab and are linked into one of kLevels x kSlots buckets by their expiry tick,
+ * so Schedule and Cancel are O(1) and allocate nothing once the slab has grown. Timers far in the
+ * future sit in coarse levels and are cascaded down as the wheel turns. The libevent timer is
+ * armed for the next occupied bucket only, and not at all while no timer is pending.
+ *
+ * Timers fire with tick granularity, never early. Not thread safe, use from the loop thread.
+ */
+class TimerWheel {
+  static void TickFn(evutil_socket_t, short, void *handler);
+  // turns the wheel by hand, without waiting for the clock
+  friend class TimerWheelTest;
+
+public:
+  using TimerId = uint64_t;
+  static constexpr TimerId kInvalidTimer = 0;
+  static constexpr std::chrono::milliseconds kDefaultTick{10};
+
+  explicit TimerWheel(EventLoop *loop, std::chrono::milliseconds tick = kDefaultTick);
+  ~TimerWheel() = default;
+
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+
+  // run task once after delay, the returned id stays unique until it is cancelled or fired
+  TimerId Schedule(std::chrono::milliseconds delay, Task &&task);
+
+  // returns false when the timer already fired or was cancelled
+  bool Cancel(TimerId id);
+
+  // number of pending timers
+  size_t Size() const { return size_; }
+
+private:
+  static constexpr int kSlotBits = 6;
+  static constexpr uint32_t kSlots = 1u << kSlotBits;
+  static constexpr int kLevels = 4;
+  // cascade list and expired list after the wheel buckets
+  static constexpr uint32_t kCascadeList = kLevels * kSlots;
+  static constexpr uint32_t kExpiredList = kCascadeList + 1;
+  static constexpr uint32_t kNil = UINT32_MAX;
+
+  struct Node {
+    Task task;
+    int64_t expire = 0;
+    uint32_t prev = kNil;
+    uint32_t next = kNil;
+    uint32_t list = kNil;
+    // bumped every time the node is released, part of the TimerId
+    uint32_t generation = 1;
+  };
+
+  int64_t NowTick() const;
+  void Link(uint32_t index, uint32_t list);
+  void Unlink(uint32_t index);
+  void Release(uint32_t index);
+  // put a node in the bucket matching its expiry relative to current_
+  void Place(uint32_t index);
+  // move every node of a bucket into lower levels
+  void Cascade(int level, uint32_t slot);
+  void Advance(int64_t target);
+  void Rearm();
+
+private:
+  EventLoop *loop_;
+  EventPtr event_;
+  std::chrono::milliseconds tick_;
+  std::chrono::steady_clock::time_point origin_;
+  // next tick to be processed
+  int64_t current_ = 0;
+  std::vector<Node> nodes_;
+  std::vector<uint32_t> free_;
+  std::array<uint32_t, kExpiredList + 1> heads_;
+  // occupied buckets of every level
+  std::array<uint64_t, kLevels> occupied_{};
+  size_t size_ = 0;
+};
+
+/**
+ * A rearmable timer on a TimerWheel with the same interface as Core::Component::TimerChannel,
+ * the callback runs once per enable.
+ */
+class WheelTimer {
+public:
+  WheelTimer(TimerWheel *wheel, std::function<void()> callback) : wheel_(wheel), callback_(std::move(callback)) {}
+  ~WheelTimer() { disable(); }
+
+  WheelTimer(const WheelTimer &) = delete;
+  WheelTimer &operator=(const WheelTimer &) = delete;
+
+  template <typename Duration> void enable(Duration timeout) {
+    disable();
+    id_ = wheel_->Schedule(std::chrono::duration_cast<std::chrono::milliseconds>(timeout), [this]() {
+      id_ = TimerWheel::kInvalidTimer;
+      callback_();
+    });
+  }
+
+  void disable() {
+    if (id_ != TimerWheel::kInvalidTimer) {
+      wheel_->Cancel(id_);
+      id_ = TimerWheel::kInvalidTimer;
+    }
+  }
+
+  bool enabled() const { return id_ != TimerWheel::kInvalidTimer; }
+
+private:
+  TimerWheel *wheel_;
+  std::function<void()> callback_;
+  TimerWheel::TimerId id_ = TimerWheel::kInvalidTimer;
+};
+} // namespace Core::Event
@@ -1,9 +1,100 @@
 #include "process/async_queue.h"
 #include <spdlog/spdlog.h>
 #include <sys/eventfd.h>
+#include <thread>
 #include <unistd.h>
 
-Core::Event::AsyncQueue::AsyncQueue(Core::Event::EventLoop *loop) : loop_(loop) {
+static uint64_t RoundUpPowerOfTwo(size_t n) {
+  uint64_t capacity = 2;
+  while (capacity < n) capacity <<= 1;
+  return capacity;
+}
+
+Core::Event::TaskQueue::TaskQueue(size_t capacity)
+    : mask_(RoundUpPowerOfTwo(capacity) - 1), slots_(new Slot[mask_ + 1]) {
+  for (uint64_t i = 0; i <= mask_; i++) {
+    slots_[i].seq.store(i, std::memory_order_relaxed);
+  }
+}
+
+void Core::Event::TaskQueue::Push(Task &&task, int64_t stamp) {
+  if (!spilling_.load(std::memory_order_acquire) && TryPushRing(task, stamp)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(spill_mutex_);
+  spill_.push_back({std::move(task), stamp});
+  spilling_.store(true, std::memory_order_release);
+}
+
+bool Core::Event::TaskQueue::TryPushRing(Task &task, int64_t stamp) {
+  uint64_t pos = tail_.load(std::memory_order_relaxed);
+  while (true) {
+    Slot &slot = slots_[pos & mask_];
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    auto diff = static_cast<int64_t>(seq - pos);
+    if (diff == 0) {
+      if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        slot.task = std::move(task);
+        slot.stamp = stamp;
+        slot.seq.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      // ring is full
+      return false;
+    } else {
+      pos = tail_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool Core::Event::TaskQueue::TryPopRing(Task &task, int64_t &stamp, bool wait) {
+  Slot &slot = slots_[head_ & mask_];
+  while (slot.seq.load(std::memory_order_acquire) != head_ + 1) {
+    // empty, or a producer has claimed the slot but not published it yet
+    if (!wait) return false;
+    std::this_thread::yield();
+  }
+  task = std::move(slot.task);
+  stamp = slot.stamp;
+  slot.seq.store(head_ + mask_ + 1, std::memory_order_release);
+  head_++;
+  return true;
+}
+
+bool Core::Event::TaskQueue::Pop(Task &task, int64_t &stamp) {
+  while (true) {
+    if (!spill_batch_.empty()) {
+      // everything claimed in the ring before the spill was taken goes first
+      if (head_ < spill_fence_) {
+        return TryPopRing(task, stamp, true);
+      }
+      task = std::move(spill_batch_.front().task);
+      stamp = spill_batch_.front().stamp;
+      spill_batch_.pop_front();
+      return true;
+    }
+
+    if (TryPopRing(task, stamp, false)) {
+      return true;
+    }
+
+    if (!spilling_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(spill_mutex_);
+    spill_batch_.swap(spill_);
+    spill_fence_ = tail_.load(std::memory_order_acquire);
+    spilling_.store(false, std::memory_order_release);
+  }
+}
+
+Core::Event::AsyncQueue::AsyncQueue(Core::Event::EventLoop *loop, size_t capacity) : loop_(loop) {
+  for (auto &lane : lanes_) {
+    lane = std::make_unique<Lane>(capacity);
+  }
+
   event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
   if (event_fd_ == -1) {
     SPDLOG_ERROR("Failed to create event fd");
@@ -17,6 +108,13 @@ Core::Event::AsyncQueue::AsyncQueue(Core::Event::EventLoop *loop) : loop_(loop)
   }
   event_.Reset(ev);
   event_add(ev, nullptr);
+
+  ev = evtimer_new(loop_->getEventBase(), ResumeFn, this);
+  if (ev == nullptr) {
+    SPDLOG_ERROR("Failed to create resume event");
+    throw std::runtime_error("Failed to create resume event");
+  }
+  resume_event_.Reset(ev);
 }
 
 Core::Event::AsyncQueue::~AsyncQueue() {
@@ -26,25 +124,66 @@ Core::Event::AsyncQueue::~AsyncQueue() {
   }
 }
 
-void Core::Event::AsyncQueue::Push(std::function<void()> &&task) {
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
-    tasks_.push(std::move(task));
+void Core::Event::AsyncQueue::Push(Task &&task, TaskPriority priority) {
+  auto &lane = lanes_[static_cast<size_t>(priority)];
+  lane->pushed.fetch_add(1, std::memory_order_relaxed);
+  lane->tasks.Push(std::move(task), Now());
+  // only the producer that turns the queue from empty to non-empty wakes the loop up
+  if (!signaled_.exchange(true, std::memory_order_acq_rel)) {
+    Notify();
   }
-  Notify();
 }
 
 void Core::Event::AsyncQueue::Process() {
-  std::queue<std::function<void()>> current_tasks;
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
-    current_tasks.swap(tasks_);
-  }
-  while (!current_tasks.empty()) {
-    auto task = std::move(current_tasks.front());
-    current_tasks.pop();
+  // clear before draining, so a task pushed while draining either is seen here or signals again
+  signaled_.exchange(false, std::memory_order_acq_rel);
+  if (budget_source_) {
+    budget_ = budget_source_();
+  }
+
+  const auto start = Now();
+  const auto max_time = std::chrono::duration_cast<std::chrono::steady_clock::duration>(budget_.max_time).count();
+  size_t executed = 0;
+  Task task;
+  int64_t stamp = 0;
+  while (auto lane = PopNext(task, stamp)) {
+    auto now = Now();
+    lane->wait_time.Record(std::chrono::steady_clock::duration(now - stamp));
     task();
+    task.Reset();
+    executed++;
+
+    if (executed >= budget_.max_tasks || Now() - start >= max_time) {
+      // out of budget: keep producers quiet and continue after libevent has polled other events
+      signaled_.store(true, std::memory_order_release);
+      timeval immediately{0, 0};
+      event_add(resume_event_.get(), &immediately);
+      yields_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+}
+
+Core::Event::AsyncQueue::Lane *Core::Event::AsyncQueue::PopNext(Task &task, int64_t &stamp) {
+  for (auto &lane : lanes_) {
+    if (lane->tasks.Pop(task, stamp)) {
+      lane->popped.fetch_add(1, std::memory_order_relaxed);
+      return lane.get();
+    }
   }
+  return nullptr;
+}
+
+uint64_t Core::Event::AsyncQueue::Depth(TaskPriority priority) const {
+  auto &lane = lanes_[static_cast<size_t>(priority)];
+  auto popped = lane->popped.load(std::memory_order_relaxed);
+  auto pushed = lane->pushed.load(std::memory_order_relaxed);
+  return pushed > popped ? pushed - popped : 0;
+}
+
+void Core::Event::AsyncQueue::ResumeFn(evutil_socket_t, short, void *handler) {
+  auto queue = reinterpret_cast<AsyncQueue *>(handler);
+  queue->Process();
 }
 
 void Core::Event::AsyncQueue::CallbackFn(evutil_socket_t fd, short, void *handler) {
@@ -57,6 +196,7 @@ void Core::Event::AsyncQueue::CallbackFn(evutil_socket_t fd, short, void *handle
         break;
       }
       SPDLOG_ERROR("Failed to read from eventfd, errno: {}", errno);
+      break;
     }
   }
 
@@ -0,0 +1,214 @@
+#include "process/cgroup_registry.h"
+#include <cerrno>
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+namespace App::Process {
+static constexpr const char *kCGroupRoot = "/sys/fs/cgroup";
+// cpu.cfs_period_us / the period of cpu.max
+static constexpr int64_t kCpuPeriodUs = 100000;
+
+CGroupHandle::~CGroupHandle() { registry_->Release(name_); }
+
+std::shared_ptr<CGroupHandle> CGroupRegistry::Acquire(const std::string &name, const CGroupLimits &limits) {
+  // "name" and "/name" are the same cgroup
+  std::string key = Relative(name);
+  auto iter = entries_.find(key);
+  if (iter != entries_.end()) {
+    if (auto handle = iter->second.handle.lock()) {
+      Apply(key, iter->second, limits);
+      return handle;
+    }
+  }
+
+  Entry entry;
+  // OS::CGroup only creates it without limits, they are written by Apply so that Writes() counts
+  // the writes that succeeded and a failed one is retried with the next Acquire or Update
+  entry.cgroup = std::make_shared<OS::CGroup>(name);
+  entry.cgroup->run();
+  auto slash = key.rfind('/');
+  if (Unified() && slash > 0) {
+    // a nested cgroup only gets the controllers its parent hands down
+    WriteControl(key.substr(0, slash), "", "cgroup.subtree_control", "+cpu +memory");
+  }
+  Apply(key, entry, limits);
+  entry.stats = std::make_unique<CGroupStats>(key, Unified(), history_);
+
+  auto handle = std::make_shared<CGroupHandle>(this, key);
+  entry.handle = handle;
+  entries_[key] = std::move(entry);
+  SPDLOG_INFO("cgroup {} created, memory={}, cpu={}", key, limits.memory, limits.cpu);
+  return handle;
+}
+
+bool CGroupRegistry::Limits(const std::string &name, CGroupLimits *limits) const {
+  auto iter = entries_.find(Relative(name));
+  if (iter == entries_.end()) {
+    return false;
+  }
+  *limits = iter->second.applied;
+  return true;
+}
+
+bool CGroupRegistry::Update(const std::string &name, const CGroupLimits &limits) {
+  std::string key = Relative(name);
+  auto iter = entries_.find(key);
+  if (iter == entries_.end()) {
+    return false;
+  }
+  Apply(key, iter->second, limits);
+  return iter->second.applied == limits;
+}
+
+bool CGroupRegistry::Freeze(const std::string &name, bool frozen) {
+  std::string key = Relative(name);
+  if (entries_.find(key) == entries_.end()) {
+    return false;
+  }
+  if (!Unified()) {
+    // the v1 freezer controller is not mounted for our cgroups
+    SPDLOG_WARN("cgroup {} can not be frozen on cgroup v1", key);
+    return false;
+  }
+  return WriteControl(key, "freezer", "cgroup.freeze", frozen ? "1" : "0");
+}
+
+void CGroupRegistry::Apply(const std::string &name, Entry &entry, const CGroupLimits &limits) {
+  bool unified = Unified();
+  if (limits.memory != entry.applied.memory) {
+    std::string value;
+    if (limits.memory <= 0) {
+      value = unified ? "max" : "-1";
+    } else {
+      value = std::to_string(static_cast<int64_t>(std::llround(limits.memory * 1024 * 1024)));
+    }
+    if (WriteControl(name, "memory", unified ? "memory.max" : "memory.limit_in_bytes", value)) {
+      entry.applied.memory = limits.memory;
+    }
+  }
+
+  if (limits.cpu != entry.applied.cpu) {
+    auto quota = static_cast<int64_t>(std::llround(limits.cpu * kCpuPeriodUs));
+    std::string value;
+    if (unified) {
+      value = (limits.cpu <= 0 ? std::string("max") : std::to_string(quota)) + " " + std::to_string(kCpuPeriodUs);
+    } else {
+      value = limits.cpu <= 0 ? "-1" : std::to_string(quota);
+    }
+    if (WriteControl(name, "cpu", unified ? "cpu.max" : "cpu.cfs_quota_us", value)) {
+      entry.applied.cpu = limits.cpu;
+    }
+  }
+}
+
+std::string CGroupRegistry::Directory(const std::string &name, const char *controller) {
+  return std::string(kCGroupRoot) + (Unified() ? "" : std::string("/") + controller) + Relative(name);
+}
+
+std::string CGroupRegistry::ControlPath(const std::string &name, const char *controller, const char *file) {
+  return Directory(name, controller) + "/" + file;
+}
+
+bool CGroupRegistry::WriteControl(const std::string &name, const char *controller, const char *file,
+                                  const std::string &value) {
+  std::string path = ControlPath(name, controller, file);
+  int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd == -1) {
+    SPDLOG_ERROR("open {} failed, errno={}, message={}", path, errno, strerror(errno));
+    return false;
+  }
+  bool ok = write(fd, value.data(), value.size()) == static_cast<ssize_t>(value.size());
+  if (!ok) {
+    SPDLOG_ERROR("write {} to {} failed, errno={}, message={}", value, path, errno, strerror(errno));
+  }
+  close(fd);
+  if (!ok) {
+    return false;
+  }
+  writes_++;
+  SPDLOG_INFO("cgroup {} {} set to {}", name, file, value);
+  return true;
+}
+
+void CGroupRegistry::Sample() {
+  auto nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+                   .count();
+  for (auto &[name, entry] : entries_) {
+    entry.stats->Sample(nowMs);
+  }
+}
+
+void CGroupRegistry::SetHistory(size_t history) {
+  history_ = history;
+  for (auto &[name, entry] : entries_) {
+    entry.stats->SetHistory(history);
+  }
+}
+
+bool CGroupRegistry::Latest(const std::string &name, CGroupSample *sample) const {
+  auto iter = entries_.find(Relative(name));
+  return iter != entries_.end() && iter->second.stats->Latest(sample);
+}
+
+bool CGroupRegistry::History(const std::string &name, std::vector<CGroupSample> *samples) const {
+  auto iter = entries_.find(Relative(name));
+  if (iter == entries_.end()) {
+    return false;
+  }
+  iter->second.stats->History(samples);
+  return true;
+}
+
+void CGroupRegistry::Release(const std::string &name) {
+  auto iter = entries_.find(name);
+  if (iter == entries_.end() || !iter->second.handle.expired()) {
+    return;
+  }
+  entries_.erase(iter);
+
+  std::vector<std::string> dirs;
+  if (Unified()) {
+    dirs.push_back(Directory(name, ""));
+  } else {
+    for (const char *controller : {"cpu", "memory"}) {
+      dirs.push_back(Directory(name, controller));
+    }
+  }
+  for (auto &dir : dirs) {
+    // fails with EBUSY while something the service forked is still inside
+    if (rmdir(dir.c_str()) == -1 && errno != ENOENT) {
+      SPDLOG_WARN("remove cgroup {} failed, errno={}, message={}", dir, errno, strerror(errno));
+    }
+  }
+  SPDLOG_INFO("cgroup {} released", name);
+}
+
+std::vector<std::string> CGroupRegistry::ProcsFiles(const std::string &name) {
+  std::vector<std::string> files;
+  if (name.empty()) {
+    return files;
+  }
+  if (Unified()) {
+    files.push_back(ControlPath(name, "", "cgroup.procs"));
+    return files;
+  }
+  for (const char *controller : {"cpu", "memory"}) {
+    files.push_back(ControlPath(name, controller, "cgroup.procs"));
+  }
+  return files;
+}
+
+bool CGroupRegistry::Unified() {
+  static const bool unified = access((std::string(kCGroupRoot) + "/cgroup.controllers").c_str(), F_OK) == 0;
+  return unified;
+}
+
+std::string CGroupRegistry::Relative(const std::string &name) {
+  return !name.empty() && name[0] == '/' ? name : "/" + name;
+}
+} // namespace App::Process
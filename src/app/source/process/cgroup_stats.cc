@@ -0,0 +1,258 @@
+#include "process/cgroup_stats.h"
+#include <algorithm>
+#include <charconv>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "process/cgroup_registry.h"
+
+namespace App::Process {
+namespace {
+// large enough for memory.stat of recent kernels, the keys we need come first anyway
+constexpr size_t kReadBuffer = 8192;
+
+// calls fn(key, value) for every "key value" line
+template <typename Fn> void ForEachKeyed(std::string_view data, Fn &&fn) {
+  while (!data.empty()) {
+    auto eol = data.find('\n');
+    auto line = data.substr(0, eol);
+    data.remove_prefix(eol == std::string_view::npos ? data.size() : eol + 1);
+    auto space = line.find(' ');
+    if (space != std::string_view::npos) {
+      fn(line.substr(0, space), CGroupStats::ParseValue(line.substr(space + 1)));
+    }
+  }
+}
+} // namespace
+
+CGroupStats::CGroupStats(std::string name, bool unified, size_t history) : name_(std::move(name)), unified_(unified) {
+  fds_.fill(-1);
+  SetHistory(history);
+}
+
+CGroupStats::~CGroupStats() {
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+std::string CGroupStats::Path(File file) const {
+  const char *controller = "";
+  const char *name = nullptr;
+  switch (file) {
+  case kCpuStat:
+    controller = "cpu";
+    name = "cpu.stat";
+    break;
+  case kCpuUsage:
+    // read from the cpu hierarchy like everything else about cpu: the processes are only placed in
+    // that one (see CGroupRegistry::ProcsFiles), cpuacct.usage is there when cpu and cpuacct are
+    // mounted together, the usual cpu,cpuacct layout
+    controller = "cpu";
+    name = unified_ ? nullptr : "cpuacct.usage";
+    break;
+  case kMemoryCurrent:
+    controller = "memory";
+    name = unified_ ? "memory.current" : "memory.usage_in_bytes";
+    break;
+  case kMemoryStat:
+    controller = "memory";
+    name = "memory.stat";
+    break;
+  case kMemoryEvents:
+    name = unified_ ? "memory.events" : nullptr;
+    break;
+  case kIoStat:
+    name = unified_ ? "io.stat" : nullptr;
+    break;
+  case kPidsCurrent:
+    controller = "pids";
+    name = "pids.current";
+    break;
+  default:
+    break;
+  }
+  if (name == nullptr) {
+    return "";
+  }
+  return CGroupRegistry::ControlPath(name_, controller, name);
+}
+
+int CGroupStats::Open(File file) {
+  if (!tried_[file]) {
+    tried_[file] = true;
+    auto path = Path(file);
+    if (!path.empty()) {
+      fds_[file] = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+  }
+  return fds_[file];
+}
+
+bool CGroupStats::Sample(int64_t nowMs) {
+  CGroupSample sample;
+  sample.timeMs = nowMs;
+  char buffer[kReadBuffer];
+  bool read = false;
+  for (int i = 0; i < kFileCount; i++) {
+    auto file = static_cast<File>(i);
+    int fd = Open(file);
+    if (fd < 0) {
+      continue;
+    }
+    ssize_t n = pread(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      continue;
+    }
+    read = true;
+    std::string_view data(buffer, n);
+    switch (file) {
+    case kCpuStat:
+      ParseCpuStat(data, unified_, &sample);
+      break;
+    case kCpuUsage:
+      // nanoseconds
+      sample.cpuUsec = ParseValue(data) / 1000;
+      break;
+    case kMemoryCurrent:
+      sample.memoryBytes = ParseValue(data);
+      break;
+    case kMemoryStat:
+      ParseMemoryStat(data, unified_, &sample);
+      break;
+    case kMemoryEvents:
+      ParseMemoryEvents(data, &sample);
+      break;
+    case kIoStat:
+      ParseIoStat(data, &sample);
+      break;
+    case kPidsCurrent:
+      sample.pids = ParseValue(data);
+      break;
+    default:
+      break;
+    }
+  }
+  if (!read) {
+    return false;
+  }
+  ring_[head_] = sample;
+  head_ = (head_ + 1) % ring_.size();
+  count_ = std::min(count_ + 1, ring_.size());
+  return true;
+}
+
+void CGroupStats::SetHistory(size_t history) {
+  history = std::max<size_t>(history, 1);
+  if (history == ring_.size()) {
+    return;
+  }
+  std::vector<CGroupSample> samples;
+  History(&samples);
+  size_t keep = std::min(samples.size(), history);
+  ring_.assign(history, CGroupSample{});
+  std::copy(samples.end() - keep, samples.end(), ring_.begin());
+  count_ = keep;
+  head_ = keep % history;
+}
+
+bool CGroupStats::Latest(CGroupSample *sample) const {
+  if (count_ == 0) {
+    return false;
+  }
+  *sample = ring_[(head_ + ring_.size() - 1) % ring_.size()];
+  return true;
+}
+
+void CGroupStats::History(std::vector<CGroupSample> *samples) const {
+  samples->clear();
+  samples->reserve(count_);
+  for (size_t i = 0; i < count_; i++) {
+    samples->push_back(ring_[(head_ + ring_.size() - count_ + i) % ring_.size()]);
+  }
+}
+
+uint64_t CGroupStats::ParseValue(std::string_view data) {
+  uint64_t value = 0;
+  std::from_chars(data.data(), data.data() + data.size(), value);
+  return value;
+}
+
+void CGroupStats::ParseCpuStat(std::string_view data, bool unified, CGroupSample *sample) {
+  ForEachKeyed(data, [unified, sample](std::string_view key, uint64_t value) {
+    if (key == "nr_throttled") {
+      sample->nrThrottled = value;
+    } else if (!unified) {
+      if (key == "throttled_time") {
+        sample->throttledUsec = value / 1000;
+      }
+    } else if (key == "usage_usec") {
+      sample->cpuUsec = value;
+    } else if (key == "user_usec") {
+      sample->cpuUserUsec = value;
+    } else if (key == "system_usec") {
+      sample->cpuSystemUsec = value;
+    } else if (key == "throttled_usec") {
+      sample->throttledUsec = value;
+    }
+  });
+}
+
+void CGroupStats::ParseMemoryStat(std::string_view data, bool unified, CGroupSample *sample) {
+  ForEachKeyed(data, [unified, sample](std::string_view key, uint64_t value) {
+    if (key == (unified ? "anon" : "rss")) {
+      sample->anonBytes = value;
+    } else if (key == (unified ? "file" : "cache")) {
+      sample->fileBytes = value;
+    } else if (unified && key == "kernel") {
+      sample->kernelBytes = value;
+    }
+  });
+}
+
+void CGroupStats::ParseMemoryEvents(std::string_view data, CGroupSample *sample) {
+  ForEachKeyed(data, [sample](std::string_view key, uint64_t value) {
+    if (key == "high") {
+      sample->memoryHigh = value;
+    } else if (key == "max") {
+      sample->memoryMax = value;
+    } else if (key == "oom") {
+      sample->oom = value;
+    } else if (key == "oom_kill") {
+      sample->oomKill = value;
+    }
+  });
+}
+
+void CGroupStats::ParseIoStat(std::string_view data, CGroupSample *sample) {
+  while (!data.empty()) {
+    auto eol = data.find('\n');
+    auto line = data.substr(0, eol);
+    data.remove_prefix(eol == std::string_view::npos ? data.size() : eol + 1);
+    // skip "major:minor"
+    auto space = line.find(' ');
+    while (space != std::string_view::npos) {
+      line.remove_prefix(space + 1);
+      space = line.find(' ');
+      auto field = line.substr(0, space);
+      auto equal = field.find('=');
+      if (equal == std::string_view::npos) {
+        continue;
+      }
+      auto key = field.substr(0, equal);
+      auto value = ParseValue(field.substr(equal + 1));
+      if (key == "rbytes") {
+        sample->ioReadBytes += value;
+      } else if (key == "wbytes") {
+        sample->ioWriteBytes += value;
+      } else if (key == "rios") {
+        sample->ioReads += value;
+      } else if (key == "wios") {
+        sample->ioWrites += value;
+      }
+    }
+  }
+}
+} // namespace App::Process
@@ -0,0 +1,150 @@
+#include "process/child_watcher.h"
+#include "process/process.h"
+#include <cerrno>
+#include <cstring>
+#include <spdlog/spdlog.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+namespace App::Process {
+ChildWatcher::Child::~Child() {
+  if (ev) {
+    event_free(ev);
+  }
+  if (pidfd != -1) {
+    close(pidfd);
+  }
+}
+
+ChildWatcher::ChildWatcher(Core::Event::EventLoop *loop, ExitCallback callback)
+    : loop_(loop), callback_(std::move(callback)) {}
+
+ChildWatcher::~ChildWatcher() {
+  for (auto &[pid, child] : children_) {
+    if (child->process) {
+      child->process->detachWatcher();
+    }
+  }
+}
+
+int ChildWatcher::openPidfd(pid_t pid) { return static_cast<int>(syscall(SYS_pidfd_open, pid, 0)); }
+
+void ChildWatcher::watch(Process *process, int pidfd) {
+  pid_t pid = process->getPid();
+  if (pid <= 0) {
+    if (pidfd != -1) close(pidfd);
+    return;
+  }
+
+  auto child = std::make_unique<Child>();
+  child->watcher = this;
+  child->process = process;
+  child->pid = pid;
+
+  if (pidfd == -1 && pidfd_supported_) {
+    pidfd = openPidfd(pid);
+    if (pidfd == -1 && errno == ENOSYS) {
+      SPDLOG_WARN("pidfd_open is not supported, fall back to SIGCHLD");
+      pidfd_supported_ = false;
+    } else if (pidfd == -1) {
+      SPDLOG_ERROR("pidfd_open failed, pid={}, errno={}, message={}", pid, errno, strerror(errno));
+    }
+  }
+
+  if (pidfd != -1) {
+    child->pidfd = pidfd;
+    child->ev = event_new(loop_->getEventBase(), pidfd, EV_READ, onPidfdReadable, child.get());
+    if (child->ev == nullptr || event_add(child->ev, nullptr) != 0) {
+      fallBack(child.get());
+    }
+  } else {
+    fallback_.insert(pid);
+  }
+
+  process->attachWatcher(weak_from_this());
+  children_[pid] = std::move(child);
+}
+
+void ChildWatcher::unwatch(pid_t pid) {
+  auto iter = children_.find(pid);
+  if (iter != children_.end()) {
+    iter->second->process = nullptr;
+  }
+}
+
+void ChildWatcher::fallBack(Child *child) {
+  SPDLOG_ERROR("Failed to watch pidfd, pid={}, fall back to SIGCHLD", child->pid);
+  if (child->ev != nullptr) {
+    event_free(child->ev);
+    child->ev = nullptr;
+  }
+  fallback_.insert(child->pid);
+}
+
+void ChildWatcher::onPidfdReadable(evutil_socket_t /*fd*/, short /*events*/, void *param) {
+  auto child = static_cast<Child *>(param);
+  child->watcher->reap(child->pid, WNOHANG);
+}
+
+void ChildWatcher::onSigChld() {
+  // children with a pidfd are reaped by their own event, reaping dispatches and erases from the set
+  std::vector<pid_t> pids(fallback_.begin(), fallback_.end());
+  for (pid_t pid : pids) {
+    reap(pid, WNOHANG);
+  }
+}
+
+void ChildWatcher::reap(pid_t pid, int options) {
+  int status = 0;
+  struct rusage usage {};
+  pid_t ret;
+  do {
+    ret = wait4(pid, &status, options, &usage);
+  } while (ret == -1 && errno == EINTR);
+
+  if (ret == 0) {
+    // spurious wakeup, the child is still running, the pidfd event is not persistent
+    auto iter = children_.find(pid);
+    if (iter != children_.end() && iter->second->ev != nullptr && event_add(iter->second->ev, nullptr) != 0) {
+      fallBack(iter->second.get());
+    }
+    return;
+  }
+  if (ret == -1) {
+    SPDLOG_ERROR("wait4 failed, pid={}, errno={}, message={}", pid, errno, strerror(errno));
+    fallback_.erase(pid);
+    children_.erase(pid);
+    return;
+  }
+  dispatch(pid, status, usage);
+}
+
+void ChildWatcher::dispatch(pid_t pid, int status, const struct rusage &usage) {
+  auto iter = children_.find(pid);
+  if (iter == children_.end()) {
+    SPDLOG_INFO("reaped unknown child {}, status={}", pid, status);
+    return;
+  }
+  // the Child owns the event we may be running in, release it after the callback returned
+  auto child = std::move(iter->second);
+  children_.erase(iter);
+  fallback_.erase(pid);
+
+  Process *process = child->process;
+  if (process == nullptr) {
+    SPDLOG_INFO("reaped child {} of a removed process, status={}", pid, status);
+    return;
+  }
+  process->detachWatcher();
+  process->onExit(status, usage);
+  if (callback_) {
+    callback_(*process);
+  }
+}
+} // namespace App::Process
@@ -0,0 +1,163 @@
+#include "process/command_line.h"
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace App::Process {
+static constexpr const char *kShell = "/bin/sh";
+static constexpr const char *kDefaultPath = "/usr/local/sbin:/usr/local/bin:/usr/sbin:/usr/bin:/sbin:/bin";
+
+static bool IsExecutable(const std::string &path) {
+  struct stat st {};
+  return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(path.c_str(), X_OK) == 0;
+}
+
+std::shared_ptr<const CommandLine> CommandLine::Parse(const std::string &command, bool shell, std::string *error) {
+  std::shared_ptr<CommandLine> line(new CommandLine());
+  line->command_ = command;
+  line->shellRequested_ = shell;
+
+  std::vector<std::string> args;
+  bool needShell = false;
+  if (!Tokenize(command, &args, &needShell)) {
+    *error = "unterminated quote or escape";
+    return nullptr;
+  }
+  if (args.empty()) {
+    *error = "empty command";
+    return nullptr;
+  }
+
+  if (shell || needShell) {
+    line->shell_ = true;
+    line->path_ = kShell;
+    line->Build({"sh", "-c", command});
+    return line;
+  }
+
+  if (!ResolveBinary(args[0], &line->path_)) {
+    *error = "executable not found: " + args[0];
+    return nullptr;
+  }
+  line->Build(std::move(args));
+  return line;
+}
+
+bool CommandLine::Tokenize(const std::string &command, std::vector<std::string> *args, bool *needShell) {
+  std::string token;
+  bool inToken = false;
+  size_t i = 0;
+  auto flush = [&]() {
+    if (inToken) {
+      // VAR=value prefix only means something to a shell
+      if (args->empty() && token.find('=') != std::string::npos && token.find('/') == std::string::npos) {
+        *needShell = true;
+      }
+      args->push_back(std::move(token));
+      token.clear();
+      inToken = false;
+    }
+  };
+
+  while (i < command.size()) {
+    char c = command[i];
+    switch (c) {
+    case ' ':
+    case '\t':
+      flush();
+      i++;
+      break;
+    case '\'': {
+      auto end = command.find('\'', i + 1);
+      if (end == std::string::npos) return false;
+      token.append(command, i + 1, end - i - 1);
+      inToken = true;
+      i = end + 1;
+      break;
+    }
+    case '"': {
+      i++;
+      while (i < command.size() && command[i] != '"') {
+        if (command[i] == '$' || command[i] == '`') {
+          *needShell = true;
+        }
+        if (command[i] == '\\' && i + 1 < command.size() && strchr("$`\"\\", command[i + 1]) != nullptr) {
+          i++;
+        }
+        token.push_back(command[i++]);
+      }
+      if (i >= command.size()) return false;
+      inToken = true;
+      i++;
+      break;
+    }
+    case '\\':
+      if (i + 1 >= command.size()) return false;
+      token.push_back(command[i + 1]);
+      inToken = true;
+      i += 2;
+      break;
+    case '#':
+    case '~':
+      // comment and home expansion only at the beginning of a word
+      if (!inToken) *needShell = true;
+      token.push_back(c);
+      inToken = true;
+      i++;
+      break;
+    default:
+      if (strchr("|&;<>()$`*?[{\n", c) != nullptr) {
+        *needShell = true;
+      }
+      token.push_back(c);
+      inToken = true;
+      i++;
+      break;
+    }
+  }
+  flush();
+  return true;
+}
+
+bool CommandLine::ResolveBinary(const std::string &name, std::string *path) {
+  if (name.find('/') != std::string::npos) {
+    *path = name;
+    return IsExecutable(name);
+  }
+
+  const char *env = getenv("PATH");
+  std::string dirs = env != nullptr && *env != '\0' ? env : kDefaultPath;
+  size_t begin = 0;
+  while (begin <= dirs.size()) {
+    auto end = dirs.find(':', begin);
+    if (end == std::string::npos) end = dirs.size();
+    std::string dir = dirs.substr(begin, end - begin);
+    std::string candidate = (dir.empty() ? "." : dir) + "/" + name;
+    if (IsExecutable(candidate)) {
+      *path = candidate;
+      return true;
+    }
+    begin = end + 1;
+  }
+  return false;
+}
+
+void CommandLine::Build(std::vector<std::string> args) {
+  args_ = std::move(args);
+  for (auto &arg : args_) {
+    argv_.push_back(arg.data());
+  }
+  argv_.push_back(nullptr);
+
+  for (char **env = environ; env != nullptr && *env != nullptr; env++) {
+    env_.emplace_back(*env);
+  }
+  for (auto &env : env_) {
+    envp_.push_back(env.data());
+  }
+  envp_.push_back(nullptr);
+}
+} // namespace App::Process
@@ -1,25 +1,59 @@
 #include "process/config.h"
+#include "process/log_file_sink.h"
 #include "process/manager.h"
+#include <google/protobuf/util/field_mask_util.h>
 #include <google/protobuf/util/json_util.h>
 #include <google/protobuf/util/message_differencer.h>
+#include <spdlog/async.h>
 #include <spdlog/pattern_formatter.h>
-#include <spdlog/sinks/rotating_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/syslog_sink.h>
 #include <spdlog/spdlog.h>
 #include <sys/types.h>
 #include <ifaddrs.h>
 #include <arpa/inet.h>
+#include <chrono>
 #include <fstream>
 #include <linux/if.h>
 
 using google::protobuf::util::JsonStringToMessage;
 
 namespace App::Process {
+// 配置的定义是 nova-agent-payload 中 manager.proto 的一份拷贝，两边的字段可能不一致，
+// 不认识的字段忽略，不让整个配置加载失败
+static google::protobuf::util::JsonParseOptions JsonOptions() {
+  google::protobuf::util::JsonParseOptions options;
+  options.ignore_unknown_fields = true;
+  return options;
+}
+
+// ManagerConfig 中除 service 以外的所有字段，重载时 service 单独交换或者拷贝
+static const google::protobuf::FieldMask &WithoutServices() {
+  static const google::protobuf::FieldMask mask = []() {
+    google::protobuf::FieldMask fields;
+    auto descriptor = ManagerConfig::descriptor();
+    for (int i = 0; i < descriptor->field_count(); i++) {
+      if (descriptor->field(i)->number() != ManagerConfig::kServiceFieldNumber) {
+        fields.add_paths(descriptor->field(i)->name());
+      }
+    }
+    return fields;
+  }();
+  return mask;
+}
+
 static const std::unordered_map<std::string, spdlog::level::level_enum> logLevels = {
     {"trace", spdlog::level::trace}, {"debug", spdlog::level::debug}, {"info", spdlog::level::info},
     {"warn", spdlog::level::warn},   {"error", spdlog::level::err},   {"off", spdlog::level::off}};
 
+// reload.timeout 没有配置时文件变化后的等待时间
+static constexpr std::chrono::milliseconds kDefaultReloadDelay(1000);
+
+// log.queue_size 没有配置时异步日志队列的长度
+static constexpr uint32_t kDefaultLogQueueSize = 8192;
+// 异步日志没有配置 log.flush_interval_secs 时定期刷盘的间隔
+static constexpr std::chrono::seconds kDefaultLogFlushInterval(1);
+
 static bool IsValidLogLevel(const std::string &level) { return logLevels.find(level) != logLevels.end(); }
 
 static auto GetLogLevel(const std::string &level) {
@@ -30,6 +64,32 @@ static auto GetLogLevel(const std::string &level) {
   return spdlog::level::info; // default log level
 }
 
+static spdlog::async_overflow_policy GetOverflowPolicy(LogConfig::Overflow overflow) {
+  switch (overflow) {
+  case LogConfig::DROP_OLDEST:
+    return spdlog::async_overflow_policy::overrun_oldest;
+  case LogConfig::DROP_NEW:
+#if SPDLOG_VERSION >= 11300
+    return spdlog::async_overflow_policy::discard_new;
+#else
+    // spdlog 1.13 之前没有 discard_new
+    return spdlog::async_overflow_policy::overrun_oldest;
+#endif
+  default:
+    return spdlog::async_overflow_policy::block;
+  }
+}
+
+static LogFileSink::Options GetLogFileOptions(const LogConfig &log) {
+  LogFileSink::Options options;
+  if (log.max_bytes() > 0) options.maxBytes = log.max_bytes();
+  if (log.backups() > 0) options.backups = log.backups();
+  options.maxAge = std::chrono::seconds(log.max_age_secs());
+  options.totalBytes = log.total_bytes();
+  options.compress = log.compression() == LogConfig::GZIP;
+  return options;
+}
+
 void GetHostNetworkCard(std::unordered_map<std::string, IpInfo> &ip_map) {
   struct ifaddrs *interfaces = nullptr;
 
@@ -80,11 +140,7 @@ IpInfo Config::GetIpInfo() const {
   for (auto &[name, ip] : ip_map) {
     SPDLOG_INFO("interface: {}, ipv6: {}, ipv4: {}", name, ip.ipv4, ip.ipv6);
   }
-  std::string network_interface;
-  {
-    std::shared_lock<std::shared_mutex> lock(rw_lock_);
-    network_interface = config_.network_interface();
-  }
+  std::string network_interface = Snapshot()->network_interface();
 
   if (!network_interface.empty()) {
     auto it = ip_map.find(network_interface);
@@ -119,42 +175,24 @@ static std::string ReadFile(const std::string &path) {
   return buffer.str();
 }
 
-static bool WriteFile(const std::string &path, const std::string &content) {
-  if (path.empty()) {
-    return false;
-  }
-
-  std::ofstream file(path);
-  if (file) {
-    file << content;
-    file.close();
-    return true;
-  }
-  return false;
-}
-
 std::string GetAbsPath(const std::string &src) {
   std::filesystem::path p(src);
   return std::filesystem::absolute(p).string();
 }
 
-Config::Config(const std::string &path) {
-  // set all path-related settings to absolute path
-  path_ = GetAbsPath(path);
-
-  {
-    std::unique_lock<std::shared_mutex> lock(rw_lock_);
-    ReadConfig(path_, config_);
-  }
+// set all path-related settings to absolute path
+Config::Config(const std::string &path) : path_(GetAbsPath(path)), cache_(path_) {
+  auto config = std::make_shared<ManagerConfig>();
+  LoadConfig(*config);
+  ParseCommands(*config);
+  fingerprints_ = IndexServices(config->mutable_service());
+  Publish(config);
 
   // init logger
-  {
-    std::shared_lock<std::shared_mutex> lock(rw_lock_);
-    UpdateLogPath(config_.daemon(), config_.log_path(), config_.log_level());
-  }
+  UpdateLogPath(config->daemon(), config->log_path(), config->log_level(), config->log());
 }
 
-void Config::UpdateLogPath(bool daemon, const std::string &path, const std::string &level) {
+void Config::UpdateLogPath(bool daemon, const std::string &path, const std::string &level, const LogConfig &log) {
   auto get_syslog_sink = [&]() -> spdlog::sink_ptr {
     if (syslog_sink_) return syslog_sink_;
     std::string ident = fmt::format("watchermen"); // syslog ident
@@ -171,9 +209,10 @@ void Config::UpdateLogPath(bool daemon, const std::string &path, const std::stri
 
   auto get_file_sink = [&](const std::string &path) -> spdlog::sink_ptr {
     if (file_sink_) {
-      auto file = std::dynamic_pointer_cast<spdlog::sinks::rotating_file_sink_mt>(file_sink_);
+      auto file = std::dynamic_pointer_cast<LogFileSink>(file_sink_);
       if (file && file->filename() == path) {
         SPDLOG_INFO("file sink already exists, path={}", path);
+        file->SetOptions(GetLogFileOptions(log));
         return file_sink_;
       }
       SPDLOG_INFO("log file changed from {} to path={}", file->filename(), path);
@@ -191,7 +230,12 @@ void Config::UpdateLogPath(bool daemon, const std::string &path, const std::stri
         SPDLOG_INFO("Failed to set FD_CLOEXEC to file: {}", filename);
       }
     };
-    file_sink_ = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(path, 1024 * 1024 * 10, 3, false, handler);
+    auto sink = std::make_shared<LogFileSink>(path, GetLogFileOptions(log), handler);
+    // 压缩切割文件的线程同样要在 fork 之后启动
+    if (log_started_) {
+      sink->Start();
+    }
+    file_sink_ = sink;
     return file_sink_;
   };
 
@@ -219,22 +263,90 @@ void Config::UpdateLogPath(bool daemon, const std::string &path, const std::stri
   if (stdout_sink_) sinks.push_back(stdout_sink_);
   if (syslog_sink_) sinks.push_back(syslog_sink_);
 
-  if (logger_) {
+  if (logger_ && !log_pool_) {
     logger_->sinks().swap(sinks);
     SPDLOG_INFO("update log sinks");
-  } else {
-    logger_ = std::make_shared<spdlog::logger>("multi", sinks.begin(), sinks.end());
-    logger_->set_level(GetLogLevel(level));
-    logger_->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] [%s:%#] %v");
-    spdlog::register_logger(logger_);
-    spdlog::set_default_logger(logger_);
-    spdlog::flush_on(spdlog::level::trace);
+    return;
   }
+  if (logger_) {
+    ResetAsyncLogger(std::move(sinks), log);
+    SPDLOG_INFO("update log sinks");
+    return;
+  }
+
+  // 异步日志等 StartAsyncLog 再切换，daemon 模式 fork 之后写日志的线程才存在
+  logger_ = std::make_shared<spdlog::logger>("multi", sinks.begin(), sinks.end());
+  logger_->set_level(GetLogLevel(level));
+  logger_->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] [%s:%#] %v");
+  spdlog::register_logger(logger_);
+  spdlog::set_default_logger(logger_);
+  UpdateLogFlush(log);
+}
+
+void Config::ResetAsyncLogger(std::vector<spdlog::sink_ptr> sinks, const LogConfig &log) {
+  // the worker thread reads the sinks of an async logger, so the whole logger is replaced instead
+  // of swapping them; messages still queued keep the old one alive
+  auto logger = std::make_shared<spdlog::async_logger>("multi", sinks.begin(), sinks.end(), log_pool_,
+                                                       GetOverflowPolicy(log.overflow()));
+  logger->set_level(logger_->level());
+  logger->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] [%s:%#] %v");
+  logger->flush_on(logger_->flush_level());
+  logger_ = logger;
+  spdlog::set_default_logger(logger_);
+}
+
+void Config::StartAsyncLog() {
+  auto snapshot = Snapshot();
+  auto &log = snapshot->log();
+  log_started_ = true;
+  if (auto file = std::dynamic_pointer_cast<LogFileSink>(file_sink_)) {
+    file->Start();
+  }
+  if (log.async() && !log_pool_ && logger_) {
+    // one worker thread writes and flushes, the loop thread only formats and enqueues
+    size_t queueSize = log.queue_size() > 0 ? log.queue_size() : kDefaultLogQueueSize;
+    log_pool_ = std::make_shared<spdlog::details::thread_pool>(queueSize, 1);
+    ResetAsyncLogger(logger_->sinks(), log);
+    SPDLOG_INFO("async logging started, queue_size={}, overflow={}", queueSize,
+                LogConfig::Overflow_Name(log.overflow()));
+  }
+  // the periodic flusher is a thread too
+  UpdateLogFlush(log);
+}
+
+void Config::UpdateLogFlush(const LogConfig &log) {
+  // 同步日志默认每条都刷盘，异步日志默认 warn 以上立即刷盘，其余定期刷盘
+  auto level = log_pool_ ? spdlog::level::warn : spdlog::level::trace;
+  if (IsValidLogLevel(log.flush_level())) {
+    level = GetLogLevel(log.flush_level());
+  }
+  spdlog::flush_on(level);
+  std::chrono::seconds interval(log.flush_interval_secs());
+  if (interval.count() == 0 && log_pool_) {
+    interval = kDefaultLogFlushInterval;
+  }
+  // 定期刷盘的线程等 StartAsyncLog 再启动，fork 之前启动的线程在 daemon 进程里不存在
+  if (!log_started_) {
+    return;
+  }
+  // 间隔为 0 时停掉定期刷盘的线程
+  spdlog::flush_every(interval);
+}
+
+uint64_t Config::LogDropped() const {
+  if (!log_pool_) {
+    return 0;
+  }
+#if SPDLOG_VERSION >= 11300
+  return log_pool_->overrun_counter() + log_pool_->discard_counter();
+#else
+  return log_pool_->overrun_counter();
+#endif
 }
 
 bool Config::ReadConfig(const std::string &file, ManagerConfig &config) {
   auto content = ReadFile(file);
-  auto status = JsonStringToMessage(content, &config);
+  auto status = JsonStringToMessage(content, &config, JsonOptions());
   if (!status.ok()) {
     SPDLOG_ERROR("JsonStringToMessage ({}) error:{}", content, status.message());
     return false;
@@ -242,17 +354,65 @@ bool Config::ReadConfig(const std::string &file, ManagerConfig &config) {
   return true;
 }
 
+void Config::BindProcessManager(Manager *m) {
+  reload_timer_.reset();
+  m_ = m;
+  if (m_) {
+    reload_timer_ = std::make_unique<Core::Event::WheelTimer>(m_->timers(), [this]() { OnLogFileChanged(); });
+  }
+}
+
+void Config::ScheduleReload() {
+  file_events_++;
+  if (!reload_timer_) {
+    OnLogFileChanged();
+    return;
+  }
+  uint32_t timeout = Snapshot()->reload().timeout();
+  auto delay = timeout > 0 ? std::chrono::seconds(timeout) : kDefaultReloadDelay;
+  // 每来一个事件都重新计时
+  reload_timer_->enable(delay);
+}
+
+bool Config::LoadConfig(ManagerConfig &config) const {
+  auto begin = std::chrono::steady_clock::now();
+  auto elapsed = [&begin]() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+  };
+  if (cache_.Load(&config)) {
+    SPDLOG_INFO("config loaded from {} in {}us", cache_.path(), elapsed());
+    return true;
+  }
+
+  // 解析前取文件的 inode、大小和 mtime，解析过程中文件被改写时缓存是过期的
+  FileIdentity source;
+  bool identified = FileIdentity::Of(path_, &source);
+  config.Clear();
+  if (!ReadConfig(path_, config)) {
+    cache_.Remove();
+    return false;
+  }
+  SPDLOG_INFO("config parsed from {} in {}us", path_, elapsed());
+  if (identified) {
+    cache_.Store(config, source);
+  }
+  return true;
+}
+
 void Config::OnServerConfig(const std::string &new_config) {
   if (new_config.empty()) return;
   // check if config is valid
   ManagerConfig temp{};
-  auto status = JsonStringToMessage(new_config, &temp);
+  auto status = JsonStringToMessage(new_config, &temp, JsonOptions());
   if (!status.ok()) {
     SPDLOG_ERROR("JsonStringToMessage failed, new config=({}) error:{}", new_config, status.message());
+    reload_failures_++;
     return;
   }
   for (auto &process : temp.service()) {
-    WriteFile(process.config_path(), process.config());
+    if (!process.config_path().empty()) {
+      files_.Write(process.config_path(), process.config());
+    }
   }
   // reload config
   ReloadConfig(temp);
@@ -262,144 +422,188 @@ void Config::OnServerConfig(const std::string &new_config) {
 }
 
 bool Config::ReloadConfig(ManagerConfig &new_config) {
-  std::unique_lock<std::shared_mutex> lock(rw_lock_);
+  std::lock_guard<std::mutex> lock(reload_lock_);
+  auto begin = std::chrono::steady_clock::now();
+  reloads_++;
+  auto current = Snapshot();
+  // 在副本上修改，发布之前读者看到的一直是旧的快照，副本先不带 service
+  auto next = std::make_shared<ManagerConfig>();
+  google::protobuf::util::FieldMaskUtil::MergeMessageTo(*current, WithoutServices(), {}, next.get());
   // following field will not be updated
   //  newConfig.set_company_uuid(config_.company_uuid());
   //  newConfig.set_version(config_.version());
   //  newConfig.set_network_interface(config_.network_interface());
-  config_.set_daemon(new_config.daemon());
+  next->set_daemon(new_config.daemon());
+  // 配置中心任务的执行预算，下一次执行时生效
+  next->mutable_async_queue()->CopyFrom(new_config.async_queue());
 
   // todo: update on the fly
-  if (IsValidLogLevel(new_config.log_level()) && new_config.log_level() != config_.log_level()) {
-    SPDLOG_INFO("update log level from {} to {}", config_.log_level(), new_config.log_level());
+  if (IsValidLogLevel(new_config.log_level()) && new_config.log_level() != current->log_level()) {
+    SPDLOG_INFO("update log level from {} to {}", current->log_level(), new_config.log_level());
     spdlog::set_level(GetLogLevel(new_config.log_level()));
-    config_.set_log_level(new_config.log_level());
+    next->set_log_level(new_config.log_level());
   }
 
-  if (!new_config.log_path().empty() && new_config.log_path() != config_.log_path()) {
-    config_.set_log_path(new_config.log_path());
-    UpdateLogPath(config_.daemon(), config_.log_path(), config_.log_level());
+  if (!new_config.log_path().empty() && new_config.log_path() != current->log_path()) {
+    next->set_log_path(new_config.log_path());
+    UpdateLogPath(next->daemon(), next->log_path(), next->log_level(), new_config.log());
   }
 
-  // cgroup 变了重启整个cgroup
-  if (!google::protobuf::util::MessageDifferencer::Equals(config_.cgroup(), new_config.cgroup())) {
-    config_.mutable_cgroup()->CopyFrom(new_config.cgroup());
-    config_.mutable_service()->CopyFrom(new_config.service());
-    for (auto &process : m_->all()) {
-      process.second->stop();
+  // 刷盘和切割方式可以直接修改，async、queue_size、overflow 重启后生效
+  if (!google::protobuf::util::MessageDifferencer::Equals(current->log(), new_config.log())) {
+    next->mutable_log()->CopyFrom(new_config.log());
+    UpdateLogFlush(new_config.log());
+    if (auto file = std::dynamic_pointer_cast<LogFileSink>(file_sink_)) {
+      file->SetOptions(GetLogFileOptions(new_config.log()));
     }
-    m_->startProcessPool();
+  }
+
+  bool cgroupChanged = !google::protobuf::util::MessageDifferencer::Equals(current->cgroup(), new_config.cgroup());
+  bool limitsChanged = cgroupChanged && OnlyLimitsChanged(current->cgroup(), new_config.cgroup());
+  if (cgroupChanged) {
+    next->mutable_cgroup()->CopyFrom(new_config.cgroup());
+    // 只改了限额，直接修改父层级cgroup，不重启进程
+    cgroupChanged = !limitsChanged;
+  }
+
+  // 父层级cgroup上的压力触发器
+  bool pressureChanged = current->pressure_size() != new_config.pressure_size();
+  for (int i = 0; !pressureChanged && i < new_config.pressure_size(); i++) {
+    pressureChanged = !google::protobuf::util::MessageDifferencer::Equals(current->pressure(i), new_config.pressure(i));
+  }
+  if (pressureChanged) {
+    next->mutable_pressure()->CopyFrom(new_config.pressure());
+  }
+
+  // 按指纹比较 service，不拷贝配置
+  FingerprintIndex fingerprints;
+  auto changes = DiffServices(fingerprints_, new_config.mutable_service(), &fingerprints);
+  fingerprints_.swap(fingerprints);
+  if (cgroupChanged || !changes.empty()) {
+    // Swap 只交换元素指针，changes 里的配置仍然有效
+    next->mutable_service()->Swap(new_config.mutable_service());
+    ParseCommands(*next);
   } else {
-    // 比较process，重启部分process
-    auto diff = DiffProcessPool(config_.service(), new_config.service());
-    if (!diff.first.empty() || !diff.second.empty()) {
-      config_.mutable_service()->CopyFrom(new_config.service());
-      // 停止旧的进程
-      if (!diff.second.empty()) {
-        m_->destroyPartProcess(diff.second);
-      }
+    // service 都没变，只有这时才拷贝
+    next->mutable_service()->CopyFrom(current->service());
+  }
 
-      // 启动新的进程
-      if (!diff.first.empty()) {
-        m_->startPartProcess(diff.first);
-      }
+  bool httpChanged = !google::protobuf::util::MessageDifferencer::Equals(current->http_server(), new_config.http_server());
+  if (httpChanged) {
+    next->mutable_http_server()->CopyFrom(new_config.http_server());
+  }
+
+  // 先发布，manager 读到的是新的配置
+  Publish(next);
+
+  if (limitsChanged) {
+    m_->updateParentCGroup();
+  }
+
+  // cgroup 变了重启整个cgroup，startProcessPool 会重新设置压力触发器
+  if (pressureChanged && !cgroupChanged) {
+    m_->armParentPressure();
+  }
+  if (cgroupChanged) {
+    m_->destroyAllProcess();
+    m_->startProcessPool();
+  } else if (!changes.empty()) {
+    // 停止旧的进程
+    if (!changes.removed.empty()) {
+      m_->destroyPartProcess(changes.removed);
+    }
+
+    // 启动新的进程和需要重启的进程
+    if (!changes.added.empty()) {
+      m_->startPartProcess(changes.added);
+    }
+    if (!changes.restart.empty()) {
+      m_->startPartProcess(changes.restart);
+    }
+
+    // 修改限额
+    if (!changes.hot.empty()) {
+      m_->updatePartProcess(changes.hot);
     }
   }
 
   // httpserver 配置是否变化，变化要重启 manager
-  if (!google::protobuf::util::MessageDifferencer::Equals(config_.http_server(), new_config.http_server())) {
-    config_.mutable_http_server()->CopyFrom(new_config.http_server());
+  if (httpChanged) {
     m_->unInstallHttpServer();
     m_->setupHttpServer();
   }
+  reload_time_.Record(std::chrono::steady_clock::now() - begin);
   return true;
 }
 
 void Config::OnLogFileChanged() {
+  if (files_.WrittenBySelf(path_)) {
+    // SaveConfig 写入引起的通知，配置已经是最新的
+    SPDLOG_DEBUG("local file written by watchermen, ignore");
+    return;
+  }
   SPDLOG_INFO("local file changed, reload config");
   ManagerConfig temp{};
-  if (!ReadConfig(path_, temp)) {
-    SPDLOG_ERROR("load config failed, path={}", path_);
+  if (!LoadConfig(temp)) {
+    // 解析失败时保留当前配置和正在运行的进程
+    SPDLOG_ERROR("load config failed, keep the current config, path={}", path_);
+    reload_failures_++;
     return;
   }
   ReloadConfig(temp);
 }
 
-DiffProcessPoolPair Config::DiffProcessPool(const google::protobuf::RepeatedPtrField<::ProcessConfig> &oldService,
-                                            const google::protobuf::RepeatedPtrField<::ProcessConfig> &newService) {
-  std::map<std::string, ::ProcessConfig> addProcessMap;
-  std::map<std::string, ::ProcessConfig> reduceProcessMap;
-  std::map<std::string, ::ProcessConfig> oldProcessMap;
-  std::map<std::string, ::ProcessConfig> newProcessMap;
-  auto oldProcessMapBegin = oldService.begin();
-  auto newProcessMapBegin = newService.begin();
-  for (; oldProcessMapBegin != oldService.end(); oldProcessMapBegin++) {
-    if (oldProcessMapBegin->process_name().empty()) {
-      continue;
-    }
-
-    if (oldProcessMapBegin->command().empty()) {
-      continue;
-    }
-
-    auto name = oldProcessMapBegin->process_name();
-    oldProcessMap[name] = *oldProcessMapBegin;
-  }
-
-  for (; newProcessMapBegin != newService.end(); newProcessMapBegin++) {
-    if (newProcessMapBegin->process_name().empty()) {
-      continue;
-    }
-
-    if (newProcessMapBegin->command().empty()) {
-      continue;
-    }
-
-    auto name = newProcessMapBegin->process_name();
-    newProcessMap[name] = *newProcessMapBegin;
-  }
+bool Config::OnlyLimitsChanged(const CGroupConfig &oldConfig, const CGroupConfig &newConfig) {
+  return oldConfig.enabled() == newConfig.enabled() && oldConfig.name() == newConfig.name();
+}
 
-  if (oldProcessMap.empty()) {
-    return {newProcessMap, oldProcessMap};
+void Config::SaveConfig() {
+  auto config = Snapshot();
+  std::string json_config;
+  auto ret = google::protobuf::util::MessageToJsonString(*config, &json_config);
+  FileIdentity source;
+  if (ret.ok() && files_.Write(path_, json_config) == FileStore::Result::kWritten &&
+      FileIdentity::Of(path_, &source)) {
+    // 新写的 JSON 文件对应的缓存，下次启动和文件变化时不用再解析 JSON
+    cache_.Store(*config, source);
   }
+}
 
-  if (newProcessMap.empty()) {
-    return {oldProcessMap, newProcessMap};
+std::shared_ptr<const CommandLine> Config::GetCommandLine(const std::string &name) const {
+  auto it = commands_.find(name);
+  if (it == commands_.end()) {
+    return nullptr;
   }
+  return it->second;
+}
 
-  // 找出新添加的进程
-  for (auto iter = newProcessMap.begin(); iter != newProcessMap.end(); iter++) {
-    auto newIter = oldProcessMap.find(iter->second.process_name());
-    if (newIter == oldProcessMap.end()) {
-      addProcessMap[iter->second.process_name()] = iter->second;
-      continue;
-    }
-
-    // 查一下已经存在的进程是否要reload
-    if (!google::protobuf::util::MessageDifferencer::Equals(iter->second, newIter->second)) {
-      addProcessMap[newIter->second.process_name()] = newIter->second;
+void Config::ParseCommands(const ManagerConfig &config) {
+  std::unordered_map<std::string, std::shared_ptr<const CommandLine>> commands;
+  for (auto &service : config.service()) {
+    if (service.process_name().empty()) continue;
+    // 命令没变的直接复用
+    auto it = commands_.find(service.process_name());
+    if (it != commands_.end() && it->second && it->second->command() == service.command() &&
+        it->second->shellRequested() == service.shell()) {
+      commands[service.process_name()] = it->second;
       continue;
     }
-  }
-
-  // 找出新减少的进程
-  for (auto iter = oldProcessMap.begin(); iter != oldProcessMap.end(); iter++) {
-    auto newIter = newProcessMap.find(iter->second.process_name());
-    if (newIter == newProcessMap.end()) {
-      reduceProcessMap[iter->second.process_name()] = iter->second;
-      continue;
+    std::string error;
+    auto line = CommandLine::Parse(service.command(), service.shell(), &error);
+    if (!line) {
+      SPDLOG_ERROR("invalid command of {}: {}, command={}", service.process_name(), error, service.command());
+    } else if (line->shell() && !service.shell()) {
+      SPDLOG_WARN("command of {} needs a shell, run it with /bin/sh -c: {}", service.process_name(),
+                  service.command());
     }
+    commands[service.process_name()] = line;
   }
-  return {addProcessMap, reduceProcessMap};
+  commands_.swap(commands);
 }
 
-void Config::SaveConfig() {
-  std::shared_lock<std::shared_mutex> lock(rw_lock_);
-  std::string json_config;
-  auto ret = google::protobuf::util::MessageToJsonString(config_, &json_config);
-  if (ret.ok()) {
-    WriteFile(path_, json_config);
-  }
+void Config::Publish(std::shared_ptr<const ManagerConfig> config) {
+  std::atomic_store(&snapshot_, std::move(config));
+  generation_.fetch_add(1, std::memory_order_release);
 }
 
 } // namespace App::Process
@@ -0,0 +1,140 @@
+#include "process/config_cache.h"
+#include "process/file_store.h"
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace App::Process {
+namespace {
+constexpr char kMagic[4] = {'W', 'M', 'C', 'F'};
+// 2 added the ctime of the JSON file
+constexpr uint32_t kVersion = 2;
+
+constexpr std::array<uint32_t, 256> MakeCrcTable() {
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+    }
+    table[i] = crc;
+  }
+  return table;
+}
+
+constexpr auto kCrcTable = MakeCrcTable();
+
+uint32_t Crc32(const void *data, size_t size) {
+  auto bytes = static_cast<const unsigned char *>(data);
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; i++) {
+    crc = kCrcTable[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+bool WriteAll(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, data, size);
+    if (n == -1) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+} // namespace
+
+bool ConfigCache::Load(ManagerConfig *config) const {
+  FileIdentity source;
+  if (!FileIdentity::Of(jsonPath_, &source)) {
+    return false;
+  }
+
+  int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    if (errno != ENOENT) {
+      SPDLOG_WARN("open config cache {} failed, errno={}, message={}", path_, errno, strerror(errno));
+    }
+    return false;
+  }
+  struct stat st {};
+  if (fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    SPDLOG_WARN("mmap config cache {} failed, errno={}, message={}", path_, errno, strerror(errno));
+    return false;
+  }
+
+  Header header;
+  memcpy(&header, addr, sizeof(header));
+  const char *payload = static_cast<const char *>(addr) + sizeof(Header);
+  bool ok = false;
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+    SPDLOG_INFO("config cache {} has an unknown format", path_);
+  } else if (header.inode != source.inode || header.mtimeNs != source.mtimeNs || header.ctimeNs != source.ctimeNs ||
+             header.jsonSize != source.size) {
+    SPDLOG_INFO("config cache {} is stale", path_);
+  } else if (header.payloadSize != size - sizeof(Header) || Crc32(payload, header.payloadSize) != header.crc) {
+    SPDLOG_WARN("config cache {} is corrupt", path_);
+  } else if (!config->ParseFromArray(payload, static_cast<int>(header.payloadSize))) {
+    SPDLOG_WARN("config cache {} cannot be parsed", path_);
+  } else {
+    ok = true;
+  }
+  munmap(addr, size);
+  return ok;
+}
+
+bool ConfigCache::Store(const ManagerConfig &config, const FileIdentity &source) const {
+  std::string payload;
+  if (!config.SerializeToString(&payload)) {
+    SPDLOG_ERROR("serialize config cache failed");
+    return false;
+  }
+  Header header{};
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.inode = source.inode;
+  header.mtimeNs = source.mtimeNs;
+  header.ctimeNs = source.ctimeNs;
+  header.jsonSize = source.size;
+  header.payloadSize = payload.size();
+  header.crc = Crc32(payload.data(), payload.size());
+
+  // write aside and rename, a reader sees the old cache or the new one
+  std::string tmp = path_ + ".tmp";
+  int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    SPDLOG_ERROR("open {} failed, errno={}, message={}", tmp, errno, strerror(errno));
+    return false;
+  }
+  bool ok = WriteAll(fd, reinterpret_cast<const char *>(&header), sizeof(header)) &&
+            WriteAll(fd, payload.data(), payload.size());
+  close(fd);
+  if (!ok || rename(tmp.c_str(), path_.c_str()) == -1) {
+    SPDLOG_ERROR("write config cache {} failed, errno={}, message={}", path_, errno, strerror(errno));
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+void ConfigCache::Remove() const {
+  if (unlink(path_.c_str()) == -1 && errno != ENOENT) {
+    SPDLOG_WARN("remove config cache {} failed, errno={}, message={}", path_, errno, strerror(errno));
+  }
+}
+} // namespace App::Process
@@ -0,0 +1,92 @@
+#include "process/config_diff.h"
+#include <cstring>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+namespace App::Process {
+namespace {
+constexpr uint64_t kFnvOffset = 14695981039346656037ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+
+uint64_t Fnv1a(const void *data, size_t size, uint64_t hash = kFnvOffset) {
+  auto bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+bool Valid(const ProcessConfig &service) { return !service.process_name().empty() && !service.command().empty(); }
+} // namespace
+
+ServiceFingerprint FingerprintService(ProcessConfig *service) {
+  // reused between calls, the loop thread is the only caller
+  static thread_local std::string buffer;
+
+  ServiceFingerprint fingerprint;
+  bool hasCGroup = service->has_cgroup();
+  CGroupConfig *cgroup = hasCGroup ? service->release_cgroup() : nullptr;
+
+  buffer.clear();
+  {
+    google::protobuf::io::StringOutputStream stream(&buffer);
+    google::protobuf::io::CodedOutputStream output(&stream);
+    output.SetSerializationDeterministic(true);
+    service->SerializeToCodedStream(&output);
+  }
+  fingerprint.restart = Fnv1a(buffer.data(), buffer.size());
+
+  if (hasCGroup) {
+    // placement in the cgroup hierarchy needs a restart, the limits do not
+    bool enabled = cgroup->enabled();
+    fingerprint.restart = Fnv1a(&enabled, sizeof(enabled), fingerprint.restart);
+    fingerprint.restart = Fnv1a(cgroup->name().data(), cgroup->name().size(), fingerprint.restart);
+    float limits[] = {cgroup->memory(), cgroup->cpu()};
+    fingerprint.limits = Fnv1a(limits, sizeof(limits));
+    service->set_allocated_cgroup(cgroup);
+  }
+  return fingerprint;
+}
+
+FingerprintIndex IndexServices(google::protobuf::RepeatedPtrField<ProcessConfig> *services) {
+  FingerprintIndex index;
+  index.reserve(services->size());
+  for (auto &service : *services) {
+    if (Valid(service)) {
+      index[service.process_name()] = FingerprintService(&service);
+    }
+  }
+  return index;
+}
+
+ServiceChangeSet DiffServices(const FingerprintIndex &loaded, google::protobuf::RepeatedPtrField<ProcessConfig> *services,
+                              FingerprintIndex *index) {
+  ServiceChangeSet changes;
+  index->clear();
+  index->reserve(services->size());
+  for (auto &service : *services) {
+    if (!Valid(service)) {
+      continue;
+    }
+    auto fingerprint = FingerprintService(&service);
+    (*index)[service.process_name()] = fingerprint;
+
+    auto iter = loaded.find(service.process_name());
+    if (iter == loaded.end()) {
+      changes.added.push_back(&service);
+    } else if (iter->second.restart != fingerprint.restart) {
+      changes.restart.push_back(&service);
+    } else if (iter->second.limits != fingerprint.limits) {
+      changes.hot.push_back(&service);
+    }
+  }
+
+  for (auto &[name, fingerprint] : loaded) {
+    if (!index->contains(name)) {
+      changes.removed.push_back(name);
+    }
+  }
+  return changes;
+}
+} // namespace App::Process
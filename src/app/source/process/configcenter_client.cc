@@ -1,5 +1,4 @@
 #include "process/configcenter_client.h"
-#include "component/process/process.h"
 #include "generated/grpc/agent/v1/controller.grpc.pb.h"
 #include "generated/grpc/agent/v1/controller.pb.h"
 #include <any>
@@ -77,12 +76,16 @@ struct AsyncUnaryCall : public grpc::ClientUnaryReactor {
   RequestType request{};
   ResponseType response{};
   std::function<void(const grpc::Status &, const ResponseType &)> callback;
-  explicit AsyncUnaryCall(const std::string &company_uuid) {
+  App::Process::LatencyHistogram *latency;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  explicit AsyncUnaryCall(const std::string &company_uuid, App::Process::LatencyHistogram *latency = nullptr)
+      : latency(latency) {
     context.AddMetadata("company_uuid", company_uuid);
     context.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(kGRPCTimeoutCallInSeconds));
   }
 
   void OnDone(const grpc::Status &s) override {
+    if (latency) latency->Record(std::chrono::steady_clock::now() - start);
     if (callback) callback(s, response);
   }
 };
@@ -166,8 +169,9 @@ void ConfigClient::OnRegisterResponse(const grpc::Status &s, const agent::AgentR
 }
 
 void ConfigClient::AgentRegisterAsync() {
-  auto &local_config = config_listener_->GetConfig();
-  auto *call = new AsyncUnaryCall<AgentRegisterReq, AgentRegisterRes>(local_config.company_uuid());
+  auto snapshot = config_listener_->Snapshot();
+  auto &local_config = *snapshot;
+  auto *call = new AsyncUnaryCall<AgentRegisterReq, AgentRegisterRes>(local_config.company_uuid(), &register_latency_);
   call->callback = [this, call](const grpc::Status &s, const AgentRegisterRes &res){
     OnRegisterResponse(s, res);
     delete call;
@@ -203,7 +207,7 @@ void ConfigClient::OnGetConfigResponse(const grpc::Status &s, const agent::Agent
       if (config_listener_) {
         config_listener_->OnServerConfig(config_);
         // check new address
-        auto server = config_listener_->GetConfig().network();
+        auto server = config_listener_->Snapshot()->network();
         auto new_address = fmt::format("{}:{}", server.host(), server.port());
         if (server_address_ != new_address) {
           server_address_ = new_address;
@@ -214,12 +218,13 @@ void ConfigClient::OnGetConfigResponse(const grpc::Status &s, const agent::Agent
     } else {
       SPDLOG_INFO("config not changed, ignore");
     }
-  });
+  }, Core::Event::TaskPriority::kBulk);
 }
 
 void ConfigClient::AgentGetConfigAsync() {
-  auto &local_config = config_listener_->GetConfig();
-  auto *call = new AsyncUnaryCall<AgentGetConfigReq, AgentGetConfigRes>(local_config.company_uuid());
+  auto snapshot = config_listener_->Snapshot();
+  auto &local_config = *snapshot;
+  auto *call = new AsyncUnaryCall<AgentGetConfigReq, AgentGetConfigRes>(local_config.company_uuid(), &get_config_latency_);
   call->request.set_configuuid(config_uuid_);
   // &ConfigClient::OnGetConfigResponse, this, _1, _2)
   call->callback = [this, call](const grpc::Status &s, const AgentGetConfigRes &res){
@@ -242,8 +247,9 @@ void ConfigClient::OnUnregisterResponse(const grpc::Status &s, const agent::Agen
 }
 
 void ConfigClient::AgentUnregisterAsync() {
-  auto &local_config = config_listener_->GetConfig();
-  auto *call = new AsyncUnaryCall<AgentUnregisterReq, AgentUnregisterRes>(local_config.company_uuid());
+  auto snapshot = config_listener_->Snapshot();
+  auto &local_config = *snapshot;
+  auto *call = new AsyncUnaryCall<AgentUnregisterReq, AgentUnregisterRes>(local_config.company_uuid(), &unregister_latency_);
   AgentUnregisterReq &request = call->request;
   request.set_objectid(object_id_);
   SPDLOG_INFO("AgentUnregisterReq request={}", request.ShortDebugString());
@@ -289,39 +295,44 @@ void ConfigClient::OnHeartbeatResponse(const grpc::Status &s, const agent::Agent
 }
 
 void ConfigClient::AgentHeartbeatAsync() {
-  auto &local_config = config_listener_->GetConfig();
-  auto *call = new AsyncUnaryCall<AgentHeartbeatReq, AgentHeartbeatRes>(local_config.company_uuid());
+  auto &local_config = *config_view_;
+  auto *call = new AsyncUnaryCall<AgentHeartbeatReq, AgentHeartbeatRes>(local_config.company_uuid(), &heartbeat_latency_);
   call->request.set_configuuid(config_uuid_);
   call->request.set_objectid(object_id_);
   call->request.set_name(hostname_);
   call->request.set_version(local_config.version());
   if (manager_) {
     auto agent_info = new AgentProcessInfo;
-    for (auto &[pid, p] : manager_->all()) {
+    manager_->forEachProcess([agent_info](const App::Process::Process &p) {
       auto process = agent_info->add_processlist();
-      process->set_name(p->name());
-      switch (p->getStatus()) {
-      case Process::RELOAD:
-      case Process::RELOADING:
-      case Process::RUN:
-      case Process::RUNNING:
+      process->set_name(p.name());
+      switch (p.getStatus()) {
+      case App::Process::ProcessStatus::RELOAD:
+      case App::Process::ProcessStatus::RELOADING:
+      case App::Process::ProcessStatus::RUN:
+      case App::Process::ProcessStatus::RUNNING:
         process->set_state(::agent::ProcessState::Running);
         break;
-      case Process::DELETED:
-      case Process::DELETING:
-      case Process::EXITED:
-      case Process::STOPPED:
-      case Process::STOPPING:
+      case App::Process::ProcessStatus::DELETED:
+      case App::Process::ProcessStatus::DELETING:
+      case App::Process::ProcessStatus::EXITED:
+      case App::Process::ProcessStatus::STOPPED:
+      case App::Process::ProcessStatus::STOPPING:
+      case App::Process::ProcessStatus::BACKOFF:
+      case App::Process::ProcessStatus::FATAL:
         process->set_state(::agent::ProcessState::Stopped);
         break;
-      case Process::UNKNOWN:
+      case App::Process::ProcessStatus::UNKNOWN:
         SPDLOG_WARN("unknown process state, skip");
         break;
       }
+#ifdef WATCHERMEN_HEARTBEAT_OOMKILLS
+      process->set_oomkills(p.oomKills());
+#endif
       // process->set_version() todo: ??
       auto start_time = process->mutable_starttime();
-      start_time->set_seconds(p->getStartTime());
-    }
+      start_time->set_seconds(p.getStartTime());
+    });
     call->request.set_allocated_agentprocessinfo(agent_info);
   }
   call->callback = [this, call](const grpc::Status &s, const AgentHeartbeatRes &res) {
@@ -349,11 +360,12 @@ void ConfigClient::OnServerOperate(const agent::AgentOperateRes &cmd) {
       }
     }
     AgentHeartbeatAsync();
-  });
+  }, Core::Event::TaskPriority::kControl);
 }
 
 void ConfigClient::AgentOperateAsync() {
-  auto &local_config = config_listener_->GetConfig();
+  auto snapshot = config_listener_->Snapshot();
+  auto &local_config = *snapshot;
   auto call = new AsyncServerStreamingCall<AgentOperateReq, AgentOperateRes>(local_config.company_uuid());
   call->request.set_objectid(object_id_);
   call->callback = [this, call](const agent::AgentOperateRes &req) {
@@ -399,8 +411,10 @@ void ConfigClient::OnHealthCheck() {
 
 ConfigClient::ConfigClient(ConfigureCallback *callback, App::Process::Config *config_listener,
                            App::Process::Manager *manager, Core::Event::EventLoop *loop)
-    : callback_(callback), config_listener_(config_listener), manager_(manager), loop_(loop), async_queue_(loop) {
-  auto &network = config_listener_->GetConfig().network();
+    : callback_(callback), config_listener_(config_listener), config_view_(config_listener), manager_(manager),
+      loop_(loop), async_queue_(loop) {
+  auto snapshot = config_listener_->Snapshot();
+  auto &network = snapshot->network();
   if (network.host().empty() || network.port() == 0) {
     SPDLOG_ERROR("invalid server address: {}", network.ShortDebugString());
   } else {
@@ -408,17 +422,40 @@ ConfigClient::ConfigClient(ConfigureCallback *callback, App::Process::Config *co
   }
 
   hostname_ = GetHostname();
+  Core::Event::TimerWheel *timers = manager_ ? manager_->timers() : nullptr;
+  if (!timers) {
+    own_timers_ = std::make_unique<Core::Event::TimerWheel>(loop_);
+    timers = own_timers_.get();
+  }
   register_timer_ =
-      std::make_unique<Core::Component::TimerChannel>(loop_, std::bind(&ConfigClient::AgentRegisterAsync, this));
+      std::make_unique<Core::Event::WheelTimer>(timers, std::bind(&ConfigClient::AgentRegisterAsync, this));
   heartbeat_timer_ =
-      std::make_unique<Core::Component::TimerChannel>(loop_, std::bind(&ConfigClient::AgentHeartbeatAsync, this));
+      std::make_unique<Core::Event::WheelTimer>(timers, std::bind(&ConfigClient::AgentHeartbeatAsync, this));
   // prevent the loop from exit
   heartbeat_timer_->enable(std::chrono::seconds(kHeartbeatPeriodInSeconds));
 
   health_check_timer_ =
-      std::make_unique<Core::Component::TimerChannel>(loop_, std::bind(&ConfigClient::OnHealthCheck, this));
+      std::make_unique<Core::Event::WheelTimer>(timers, std::bind(&ConfigClient::OnHealthCheck, this));
   health_check_timer_->enable(std::chrono::seconds(kHealthCheckInSeconds));
 
+  // drains run on the loop thread, like every other reader of config_view_
+  async_queue_.SetBudgetSource([this]() {
+    auto &config = config_view_->async_queue();
+    Core::Event::AsyncQueue::Budget budget;
+    if (config.max_tasks() > 0) {
+      budget.max_tasks = config.max_tasks();
+    }
+    if (config.max_time_us() > 0) {
+      budget.max_time = std::chrono::microseconds(config.max_time_us());
+    }
+    return budget;
+  });
+
+  if (manager_) {
+    metrics_ = std::make_shared<App::Process::FunctionCollectable>([this]() { return CollectMetrics(); });
+    manager_->metrics()->Register(metrics_);
+  }
+
   object_id_ = OS::getMachineId();
   auto ret = config_listener_->GetIpInfo();
   ipv4_ = ret.ipv4;
@@ -427,6 +464,39 @@ ConfigClient::ConfigClient(ConfigureCallback *callback, App::Process::Config *co
   Connect(false);
 }
 
+std::vector<prometheus::MetricFamily> ConfigClient::CollectMetrics() const {
+  using App::Process::AddHistogram;
+  using App::Process::AddSample;
+  using App::Process::MakeFamily;
+  using prometheus::MetricType;
+
+  auto calls = MakeFamily("watchermen_config_center_call_duration_seconds", "Latency of calls to the config center",
+                          MetricType::Histogram);
+  AddHistogram(calls, register_latency_, {{"method", "AgentRegister"}});
+  AddHistogram(calls, get_config_latency_, {{"method", "AgentGetConfig"}});
+  AddHistogram(calls, unregister_latency_, {{"method", "AgentUnregister"}});
+  AddHistogram(calls, heartbeat_latency_, {{"method", "AgentHeartbeat"}});
+
+  auto depth = MakeFamily("watchermen_async_queue_depth", "Tasks waiting in the async queue", MetricType::Gauge);
+  auto wait = MakeFamily("watchermen_async_queue_wait_seconds", "Time between pushing a task and running it",
+                         MetricType::Histogram);
+  for (auto [priority, name] : {std::make_pair(Core::Event::TaskPriority::kControl, "control"),
+                                std::make_pair(Core::Event::TaskPriority::kNormal, "normal"),
+                                std::make_pair(Core::Event::TaskPriority::kBulk, "bulk")}) {
+    AddSample(depth, static_cast<double>(async_queue_.Depth(priority)), {{"priority", name}});
+    AddHistogram(wait, async_queue_.WaitTime(priority), {{"priority", name}});
+  }
+  auto yields = MakeFamily("watchermen_async_queue_yields_total", "Drains cut short by the budget",
+                           MetricType::Counter);
+  AddSample(yields, static_cast<double>(async_queue_.Yields()));
+
+  std::vector<prometheus::MetricFamily> families;
+  for (auto *family : {&calls, &depth, &wait, &yields}) {
+    families.push_back(std::move(*family));
+  }
+  return families;
+}
+
 void ConfigClient::Connect(bool keepalive) {
   if (server_address_.empty()) return;
   SPDLOG_INFO("control center server address: {}", server_address_);
@@ -0,0 +1,130 @@
+#include "process/file_store.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <spdlog/spdlog.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace App::Process {
+static FileIdentity FromStat(const struct stat &st) {
+  FileIdentity identity;
+  identity.inode = st.st_ino;
+  identity.mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  identity.ctimeNs = static_cast<int64_t>(st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec;
+  identity.size = st.st_size;
+  return identity;
+}
+
+bool FileIdentity::Of(const std::string &path, FileIdentity *identity) {
+  struct stat st {};
+  if (stat(path.c_str(), &st) == -1) {
+    return false;
+  }
+  *identity = FromStat(st);
+  return true;
+}
+
+FileStore::Result FileStore::Write(const std::string &path, const std::string &content) {
+  uint64_t hash = Hash(content);
+  struct stat st {};
+  bool exists = stat(path.c_str(), &st) == 0;
+  if (exists && static_cast<uint64_t>(st.st_size) == content.size()) {
+    FileIdentity current = FromStat(st);
+    auto iter = records_.find(path);
+    if (iter != records_.end() && iter->second.identity == current && iter->second.hash == hash) {
+      // still what we wrote last time, no need to read it back
+      return Result::kUnchanged;
+    }
+    std::string disk;
+    if (ReadAll(path, &disk) && Hash(disk) == hash) {
+      records_[path] = Record{hash, current};
+      return Result::kUnchanged;
+    }
+  }
+
+  // the temporary file must be in the same file system for rename to be atomic
+  std::string tmp = path + ".XXXXXX";
+  int fd = mkostemp(tmp.data(), O_CLOEXEC);
+  if (fd == -1) {
+    SPDLOG_ERROR("create temporary file for {} failed, errno={}, message={}", path, errno, strerror(errno));
+    return Result::kFailed;
+  }
+  fchmod(fd, exists ? (st.st_mode & 07777) : 0644);
+
+  const char *data = content.data();
+  size_t left = content.size();
+  bool ok = true;
+  while (left > 0) {
+    ssize_t n = write(fd, data, left);
+    if (n == -1) {
+      if (errno == EINTR) continue;
+      ok = false;
+      break;
+    }
+    data += n;
+    left -= n;
+  }
+  ok = ok && fsync(fd) == 0;
+  ok = close(fd) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) == -1) {
+    SPDLOG_ERROR("write {} failed, errno={}, message={}", path, errno, strerror(errno));
+    unlink(tmp.c_str());
+    return Result::kFailed;
+  }
+  // make the rename itself durable
+  SyncDirectory(path);
+
+  Record record{hash, {}};
+  FileIdentity::Of(path, &record.identity);
+  records_[path] = record;
+  return Result::kWritten;
+}
+
+bool FileStore::WrittenBySelf(const std::string &path) const {
+  auto iter = records_.find(path);
+  if (iter == records_.end()) {
+    return false;
+  }
+  FileIdentity current;
+  return FileIdentity::Of(path, &current) && current == iter->second.identity;
+}
+
+uint64_t FileStore::Hash(const std::string &content) { return std::hash<std::string>{}(content); }
+
+bool FileStore::ReadAll(const std::string &path, std::string *content) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  content->clear();
+  char buffer[64 * 1024];
+  ssize_t n;
+  while ((n = read(fd, buffer, sizeof(buffer))) != 0) {
+    if (n == -1) {
+      if (errno == EINTR) continue;
+      close(fd);
+      return false;
+    }
+    content->append(buffer, n);
+  }
+  close(fd);
+  return true;
+}
+
+bool FileStore::SyncDirectory(const std::string &path) {
+  auto pos = path.rfind('/');
+  std::string dir = pos == std::string::npos ? "." : (pos == 0 ? "/" : path.substr(0, pos));
+  int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  bool ok = fsync(fd) == 0;
+  if (!ok) {
+    SPDLOG_WARN("fsync {} failed, errno={}, message={}", dir, errno, strerror(errno));
+  }
+  close(fd);
+  return ok;
+}
+} // namespace App::Process
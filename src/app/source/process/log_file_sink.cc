@@ -0,0 +1,258 @@
+#include "process/log_file_sink.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+
+namespace App::Process {
+namespace {
+// ioprio_set(2), glibc has no wrapper
+constexpr int kIoprioWhoProcess = 1;
+constexpr int kIoprioClassIdle = 3;
+constexpr int kIoprioClassShift = 13;
+constexpr size_t kCompressBuffer = 64 * 1024;
+constexpr const char *kCompressedSuffix = ".gz";
+constexpr const char *kTempSuffix = ".tmp";
+
+bool EndsWith(const std::string &value, const std::string &suffix) {
+  return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool Exists(const std::string &path) {
+  struct stat st {};
+  return stat(path.c_str(), &st) == 0;
+}
+
+// n digits at pos
+bool Digits(const std::string &value, size_t pos, size_t n) {
+  if (value.size() < pos + n) {
+    return false;
+  }
+  return std::all_of(value.begin() + pos, value.begin() + pos + n,
+                     [](char c) { return isdigit(static_cast<unsigned char>(c)) != 0; });
+}
+
+// what SegmentName appends to the prefix: yyyymmdd-hhmmss-mmm[_n], then .gz or .gz.tmp if compressed
+bool IsSegmentStamp(const std::string &name, size_t pos) {
+  if (!Digits(name, pos, 8) || name.compare(pos + 8, 1, "-") != 0 || !Digits(name, pos + 9, 6) ||
+      name.compare(pos + 15, 1, "-") != 0 || !Digits(name, pos + 16, 3)) {
+    return false;
+  }
+  pos += 19;
+  if (pos < name.size() && name[pos] == '_') {
+    size_t end = pos + 1;
+    while (end < name.size() && isdigit(static_cast<unsigned char>(name[end]))) {
+      end++;
+    }
+    if (end == pos + 1) {
+      return false;
+    }
+    pos = end;
+  }
+  std::string rest = name.substr(pos);
+  return rest.empty() || rest == kCompressedSuffix || rest == std::string(kCompressedSuffix) + kTempSuffix;
+}
+} // namespace
+
+LogFileSink::LogFileSink(std::string path, const Options &options, const spdlog::file_event_handlers &handlers)
+    : path_(std::move(path)), file_(handlers), options_(options) {
+  file_.open(path_, false);
+  size_ = file_.size();
+  opened_ = std::chrono::system_clock::now();
+}
+
+LogFileSink::~LogFileSink() {
+  {
+    std::lock_guard<std::mutex> lock(work_lock_);
+    stop_ = true;
+  }
+  work_cond_.notify_one();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+void LogFileSink::Start() {
+  std::lock_guard<std::mutex> lock(work_lock_);
+  if (!worker_.joinable()) {
+    worker_ = std::thread([this]() { Work(); });
+  }
+}
+
+void LogFileSink::SetOptions(const Options &options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::lock_guard<std::mutex> workLock(work_lock_);
+  options_ = options;
+}
+
+void LogFileSink::sink_it_(const spdlog::details::log_msg &msg) {
+  spdlog::memory_buf_t formatted;
+  formatter_->format(msg, formatted);
+  if (size_ > 0 && (size_ + formatted.size() > options_.maxBytes ||
+                    (options_.maxAge.count() > 0 && msg.time - opened_ >= options_.maxAge))) {
+    Rotate(msg.time);
+  }
+  file_.write(formatted);
+  size_ += formatted.size();
+}
+
+void LogFileSink::flush_() { file_.flush(); }
+
+std::string LogFileSink::SegmentName(std::chrono::system_clock::time_point now) const {
+  time_t seconds = std::chrono::system_clock::to_time_t(now);
+  auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+  struct tm local {};
+  localtime_r(&seconds, &local);
+  char stamp[32];
+  size_t n = strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+  snprintf(stamp + n, sizeof(stamp) - n, "-%03d", static_cast<int>(millis));
+
+  // the names sort by time, a second rotation within the same millisecond gets a suffix
+  std::string name = path_ + "." + stamp;
+  std::string segment = name;
+  for (int i = 1; Exists(segment) || Exists(segment + kCompressedSuffix); i++) {
+    segment = name + "_" + std::to_string(i);
+  }
+  return segment;
+}
+
+void LogFileSink::Rotate(std::chrono::system_clock::time_point now) {
+  // called with the sink locked, errors are thrown to the logger instead of logged
+  file_.close();
+  auto segment = SegmentName(now);
+  if (rename(path_.c_str(), segment.c_str()) != 0) {
+    int error = errno;
+    // like spdlog's rotating sink: truncate anyway so the file does not grow beyond its limit
+    file_.reopen(true);
+    size_ = 0;
+    opened_ = now;
+    spdlog::throw_spdlog_ex("rotate " + path_ + " to " + segment + " failed", error);
+  }
+  file_.open(path_, true);
+  size_ = 0;
+  opened_ = now;
+  {
+    std::lock_guard<std::mutex> lock(work_lock_);
+    pending_ = true;
+  }
+  work_cond_.notify_one();
+}
+
+void LogFileSink::Work() {
+  // the lowest CPU and IO priority, for this thread only
+  pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+  setpriority(PRIO_PROCESS, tid, 19);
+  syscall(SYS_ioprio_set, kIoprioWhoProcess, tid, kIoprioClassIdle << kIoprioClassShift);
+
+  std::unique_lock<std::mutex> lock(work_lock_);
+  for (;;) {
+    work_cond_.wait(lock, [this]() { return pending_ || stop_; });
+    if (stop_) {
+      return;
+    }
+    pending_ = false;
+    Options options = options_;
+    // no lock while compressing, the log itself may be written from here
+    lock.unlock();
+    Prune(options);
+    lock.lock();
+  }
+}
+
+bool LogFileSink::Compress(const std::string &segment) {
+  std::string target = segment + kCompressedSuffix;
+  std::string temp = target + kTempSuffix;
+  int in = open(segment.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in == -1) {
+    SPDLOG_WARN("open {} failed, errno={}, message={}", segment, errno, strerror(errno));
+    return false;
+  }
+  gzFile out = gzopen(temp.c_str(), "wbe");
+  if (out == nullptr) {
+    SPDLOG_WARN("gzopen {} failed, errno={}, message={}", temp, errno, strerror(errno));
+    close(in);
+    return false;
+  }
+  std::vector<char> buffer(kCompressBuffer);
+  bool ok = true;
+  for (;;) {
+    ssize_t n = read(in, buffer.data(), buffer.size());
+    if (n == 0) {
+      break;
+    }
+    if (n < 0 || gzwrite(out, buffer.data(), static_cast<unsigned>(n)) != n) {
+      ok = false;
+      break;
+    }
+  }
+  close(in);
+  ok = gzclose(out) == Z_OK && ok;
+  if (!ok || rename(temp.c_str(), target.c_str()) != 0) {
+    SPDLOG_WARN("compress {} failed, the segment is kept as it is", segment);
+    unlink(temp.c_str());
+    return false;
+  }
+  unlink(segment.c_str());
+  return true;
+}
+
+void LogFileSink::Prune(const Options &options) {
+  auto slash = path_.rfind('/');
+  std::string dir = slash == std::string::npos ? "." : path_.substr(0, slash == 0 ? 1 : slash);
+  std::string prefix = (slash == std::string::npos ? path_ : path_.substr(slash + 1)) + ".";
+
+  std::vector<std::string> segments;
+  DIR *handle = opendir(dir.c_str());
+  if (handle == nullptr) {
+    return;
+  }
+  while (auto entry = readdir(handle)) {
+    std::string name = entry->d_name;
+    // only what Rotate named, not path.1 of other rotation schemes
+    if (name.compare(0, prefix.size(), prefix) != 0 || !IsSegmentStamp(name, prefix.size())) {
+      continue;
+    }
+    std::string segment = dir + "/" + name;
+    if (EndsWith(name, kTempSuffix)) {
+      // left by a compression that did not finish
+      unlink(segment.c_str());
+      continue;
+    }
+    segments.push_back(std::move(segment));
+  }
+  closedir(handle);
+
+  if (options.compress) {
+    for (auto &segment : segments) {
+      if (!EndsWith(segment, kCompressedSuffix) && Compress(segment)) {
+        segment += kCompressedSuffix;
+      }
+    }
+  }
+
+  // newest first
+  std::sort(segments.begin(), segments.end(), std::greater<>());
+  uint64_t total = 0;
+  for (size_t i = 0; i < segments.size(); i++) {
+    struct stat st {};
+    if (stat(segments[i].c_str(), &st) == 0) {
+      total += st.st_size;
+    }
+    if (i >= options.backups || (options.totalBytes > 0 && total > options.totalBytes)) {
+      unlink(segments[i].c_str());
+    }
+  }
+}
+} // namespace App::Process
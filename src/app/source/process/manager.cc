@@ -12,13 +12,44 @@
 //
 #include "process/manager.h"
 
-#include "component/process/process.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
 #include "process/health_check.h"
 #include "http/http_manager.h"
+#include "process/metrics_http_helper.h"
 #include "process/process_http_helper.h"
 
 namespace App {
 namespace Process {
+// stopwaitsecs 没有配置时的默认值
+static constexpr std::chrono::seconds kDefaultStopWait{10};
+// cgroup_stats.interval_ms 没有配置时 cgroup 用量的采集间隔
+static constexpr std::chrono::milliseconds kCGroupSampleInterval{10000};
+// pressure.hold_secs 没有配置时限流和冻结的持续时间
+static constexpr std::chrono::seconds kDefaultPressureHold{30};
+// 父层级cgroup上的压力触发器
+static const std::string kParentOwner;
+// 进程组自己 cgroup 的 oom_kill 之后多久以内被 SIGKILL 杀掉的副本算作被 OOM kill，
+// 每个 oom_kill 只对应一个副本
+static constexpr std::chrono::seconds kOomAttribution{5};
+
+Manager::Manager(std::shared_ptr<App::Process::Config> config) : config_(std::move(config)) {
+    timers_ = std::make_unique<Core::Event::TimerWheel>(loop.get());
+    sampleTimer_ = std::make_unique<Core::Event::WheelTimer>(timers_.get(), [this]() { sampleCGroups(); });
+    metrics_ = std::make_shared<MetricsRegistry>();
+    collector_ = std::make_shared<FunctionCollectable>([this]() { return collectMetrics(); });
+    metrics_->Register(collector_);
+    pressure_ = std::make_unique<PressureMonitor>(loop.get(), [this](const std::string& owner,
+                                                                     const PressureConfig& config) {
+        onPressure(owner, config);
+    });
+    oom_ = std::make_unique<OomWatcher>(loop.get(), [this](const std::string& cgroup, const OomCounts& delta) {
+        onOom(cgroup, delta);
+    });
+}
+
 void Manager::start() {
     // 设置信号集
     sigset->remove(SIGTERM);
@@ -30,8 +61,15 @@ void Manager::start() {
     loop->sigAdd(SIGTERM, onStop, this);
     loop->sigAdd(SIGCHLD, onRecycle, this);
 
+    // 子进程退出通过 pidfd 投递给对应的 process
+    children_ = std::make_shared<ChildWatcher>(loop.get(), [this](App::Process::Process& process) {
+        onProcessExit(process);
+    });
+    spawner_ = std::make_unique<Spawner>();
+
     // start process pool
     startProcessPool();
+    sampleCGroups();
 
     // 开启配置发现
     discovery = std::make_shared<Core::Component::Discovery::Component>(config_->Path());
@@ -53,10 +91,14 @@ void Manager::start() {
 void Manager::setupHttpServer() {
     auto httpConfig = std::make_shared<Core::Http::HttpConfig>();
     httpManager_ = std::make_shared<Http::HttpManager>(loop, nullptr, httpConfig);
-    auto healthCheck = std::make_shared<App::Process::HealthCheck>(httpManager_, config_->GetConfig().http_server().health_config());
+    auto config = config_->Snapshot();
+    auto healthCheck = std::make_shared<App::Process::HealthCheck>(httpManager_, config->http_server().health_config());
     healthCheck->bind();
     auto processHelper = std::make_shared<App::Process::ProcessHttpHelper>(httpManager_, this);
     processHelper->bind();
+    auto metricsHelper = std::make_shared<App::Process::MetricsHttpHelper>(httpManager_, metrics_,
+                                                                           config->http_server().metric_config().path());
+    metricsHelper->bind();
     httpManager_->init();
     httpManager_->start();
 }
@@ -66,131 +108,719 @@ void Manager::unInstallHttpServer() {
 }
 
 void Manager::stop()  {
-    // 设置信号集
+    if (stopping_) {
+        return;
+    }
+    stopping_ = true;
+    sampleTimer_->disable();
     httpManager_->stop();
-    loop->quit();
     // 停止config watcher
     if (discovery) {
         discovery->stop();
     }
-    // 批量停止进程
+    // 冻结的进程收不到停止信号，先解冻
+    while (!frozen_.empty()) {
+        thaw(frozen_.begin()->first);
+    }
+    // 同时给所有进程发停止信号，最慢的进程退出或者被 kill 后再退出事件循环
+    forEachProcess([](App::Process::Process& process) { process.stop(); });
+    quitIfIdle();
+}
+
+void Manager::quitIfIdle() {
+    bool running = false;
+    forEachProcess([&running](App::Process::Process& process) { running = running || process.running(); });
+    if (running) {
+        return;
+    }
+    SPDLOG_INFO("all processes exited, quit");
+    loop->quit();
     Core::Component::Process::Manager::stop();
 }
 
+void Manager::sampleCGroups() {
+    auto config = config_->Snapshot();
+    auto& stats = config->cgroup_stats();
+    cgroups_.SetHistory(stats.history() > 0 ? stats.history() : CGroupRegistry::kDefaultHistory);
+    cgroups_.Sample();
+    auto interval = stats.interval_ms() > 0 ? std::chrono::milliseconds(stats.interval_ms()) : kCGroupSampleInterval;
+    sampleTimer_->enable(interval);
+}
+
+std::vector<prometheus::MetricFamily> Manager::collectMetrics() const {
+    using prometheus::MetricType;
+    auto state = MakeFamily("watchermen_process_state", "1 for the state the process is in", MetricType::Gauge);
+    auto restarts = MakeFamily("watchermen_process_restarts_total", "Automatic restarts of the process",
+                               MetricType::Counter);
+    auto uptime = MakeFamily("watchermen_process_uptime_seconds", "Seconds since the running process was started",
+                             MetricType::Gauge);
+    auto oomKills = MakeFamily("watchermen_process_oom_kills_total", "Exits of the process by the OOM killer",
+                               MetricType::Counter);
+    time_t now = time(nullptr);
+    forEachProcess([&](const App::Process::Process& process) {
+        MetricLabels labels{{"name", process.name()}, {"group", process.group()}};
+        AddSample(restarts, process.restarts(), labels);
+        AddSample(oomKills, process.oomKills(), labels);
+        if (process.running()) {
+            AddSample(uptime, static_cast<double>(now - process.getStartTime()), labels);
+        }
+        labels.push_back({"state", processStatusName(process.getStatus())});
+        AddSample(state, 1, std::move(labels));
+    });
+
+    // 上次采集的 cgroup 用量
+    auto memory = MakeFamily("watchermen_service_memory_bytes", "Memory used by the cgroup of the service",
+                             MetricType::Gauge);
+    auto cpu = MakeFamily("watchermen_service_cpu_seconds_total", "CPU time used by the cgroup of the service",
+                          MetricType::Counter);
+    auto throttled = MakeFamily("watchermen_service_cpu_throttled_seconds_total",
+                                "Time the cgroup of the service was throttled by its cpu limit", MetricType::Counter);
+    auto pids = MakeFamily("watchermen_service_pids", "Tasks in the cgroup of the service", MetricType::Gauge);
+    auto ioBytes = MakeFamily("watchermen_service_io_bytes_total", "Bytes read and written by the cgroup of the service",
+                              MetricType::Counter);
+    auto oomEvents = MakeFamily("watchermen_service_oom_events_total",
+                                "oom and oom_kill events of memory.events of the cgroup of the service",
+                                MetricType::Counter);
+    auto logBytes = MakeFamily("watchermen_service_log_bytes_total", "Output of the service written to its log",
+                               MetricType::Counter);
+    auto logDropped = MakeFamily("watchermen_service_log_dropped_bytes_total",
+                                 "Output of the service dropped by the rate limit or a failed write",
+                                 MetricType::Counter);
+    auto logRotations = MakeFamily("watchermen_service_log_rotations_total", "Rotations of the log of the service",
+                                   MetricType::Counter);
+    for (auto& [name, group] : groups_) {
+        for (auto& [stream, log] : {std::make_pair("stdout", group.stdoutLog.get()),
+                                    std::make_pair("stderr", group.stderrLog.get())}) {
+            if (log == nullptr) {
+                continue;
+            }
+            MetricLabels labels{{"service", name}, {"stream", stream}};
+            AddSample(logBytes, static_cast<double>(log->written()), labels);
+            AddSample(logDropped, static_cast<double>(log->dropped()), labels);
+            AddSample(logRotations, static_cast<double>(log->rotations()), std::move(labels));
+        }
+        if (group.cgroup) {
+            AddSample(oomEvents, static_cast<double>(group.oom.oom),
+                      {{"service", name}, {"cgroup", group.cgroup->name()}, {"event", "oom"}});
+            AddSample(oomEvents, static_cast<double>(group.oom.oomKill),
+                      {{"service", name}, {"cgroup", group.cgroup->name()}, {"event", "oom_kill"}});
+        }
+        CGroupSample sample;
+        if (group.cgroup && cgroups_.Latest(group.cgroup->name(), &sample)) {
+            MetricLabels labels{{"service", name}, {"cgroup", group.cgroup->name()}};
+            AddSample(memory, static_cast<double>(sample.memoryBytes), labels);
+            AddSample(cpu, sample.cpuUsec / 1e6, labels);
+            AddSample(throttled, sample.throttledUsec / 1e6, labels);
+            AddSample(pids, static_cast<double>(sample.pids), labels);
+            auto readLabels = labels;
+            readLabels.push_back({"direction", "read"});
+            AddSample(ioBytes, static_cast<double>(sample.ioReadBytes), std::move(readLabels));
+            labels.push_back({"direction", "write"});
+            AddSample(ioBytes, static_cast<double>(sample.ioWriteBytes), std::move(labels));
+        }
+    }
+
+    auto spawn = MakeFamily("watchermen_spawn_duration_seconds", "Time to fork and exec a process",
+                            MetricType::Histogram);
+    AddHistogram(spawn, spawnLatency_);
+    auto cgroups = MakeFamily("watchermen_cgroups", "Cgroups in use", MetricType::Gauge);
+    AddSample(cgroups, static_cast<double>(cgroups_.Size()));
+    auto cgroupWrites = MakeFamily("watchermen_cgroup_writes_total", "Cgroup control files written",
+                                   MetricType::Counter);
+    AddSample(cgroupWrites, static_cast<double>(cgroups_.Writes()));
+    auto timers = MakeFamily("watchermen_timers", "Pending timers on the event loop", MetricType::Gauge);
+    AddSample(timers, static_cast<double>(timers_->Size()));
+
+    auto reloads = MakeFamily("watchermen_config_reloads_total", "Config reloads", MetricType::Counter);
+    AddSample(reloads, static_cast<double>(config_->Reloads()));
+    auto reloadFailures = MakeFamily("watchermen_config_reload_failures_total",
+                                     "Configs that could not be loaded, the current config was kept",
+                                     MetricType::Counter);
+    AddSample(reloadFailures, static_cast<double>(config_->ReloadFailures()));
+    auto fileEvents = MakeFamily("watchermen_config_file_events_total", "Change events of the config file",
+                                 MetricType::Counter);
+    AddSample(fileEvents, static_cast<double>(config_->FileEvents()));
+    auto reloadTime = MakeFamily("watchermen_config_reload_duration_seconds",
+                                 "Time to apply a config, including starting and stopping processes",
+                                 MetricType::Histogram);
+    AddHistogram(reloadTime, config_->ReloadTime());
+    auto generation = MakeFamily("watchermen_config_generation", "Generation of the current config",
+                                 MetricType::Gauge);
+    AddSample(generation, static_cast<double>(config_->Generation()));
+    auto logDroppedLines = MakeFamily("watchermen_log_dropped_total",
+                                      "Lines of the watchermen log dropped because the async queue was full",
+                                      MetricType::Counter);
+    AddSample(logDroppedLines, static_cast<double>(config_->LogDropped()));
+
+    auto pressureEvents = MakeFamily("watchermen_pressure_events_total", "Events of the PSI triggers",
+                                     MetricType::Counter);
+    pressure_->ForEach([&pressureEvents](const std::string& owner, const std::string& cgroup,
+                                         const PressureConfig& config, uint64_t events) {
+        AddSample(pressureEvents, static_cast<double>(events),
+                  {{"owner", owner.empty() ? "manager" : owner},
+                   {"cgroup", cgroup},
+                   {"resource", PressureConfig::Resource_Name(config.resource())},
+                   {"action", PressureConfig::Action_Name(config.action())}});
+    });
+    auto pressureHeld = MakeFamily("watchermen_pressure_held", "Services throttled or frozen by a PSI trigger",
+                                   MetricType::Gauge);
+    AddSample(pressureHeld, static_cast<double>(throttled_.size()), {{"action", "THROTTLE"}});
+    AddSample(pressureHeld, static_cast<double>(frozen_.size()), {{"action", "FREEZE"}});
+
+    std::vector<prometheus::MetricFamily> families;
+    for (auto* family : {&state, &restarts, &uptime, &oomKills, &oomEvents, &memory, &cpu, &throttled, &pids, &ioBytes, &spawn, &cgroups, &cgroupWrites, &timers,
+                         &reloads, &reloadFailures, &fileEvents, &reloadTime, &generation, &pressureEvents,
+                         &pressureHeld, &logBytes, &logDropped, &logRotations,
+                         &logDroppedLines}) {
+        families.push_back(std::move(*family));
+    }
+    return families;
+}
+
+std::shared_ptr<CGroupHandle> Manager::createParentCGroup() {
+    auto snapshot = config_->Snapshot();
+    auto& config = snapshot->cgroup();
+    if (!config.enabled() || config.name().empty()) {
+        return nullptr;
+    }
+    return cgroups_.Acquire(config.name(), CGroupLimits{config.memory(), config.cpu()});
+}
+
+void Manager::startGroup(const ProcessConfig& processConfig, const std::shared_ptr<CGroupHandle>& parentCGroup) {
+    // 所有副本共用一个 cgroup，先于停掉旧的进程获取，cgroup 没变时不会被删除再创建
+    std::shared_ptr<CGroupHandle> cgroup = parentCGroup;
+    if (processConfig.cgroup().enabled()) {
+        cgroup = cgroups_.Acquire(cgroupName(processConfig),
+                                  CGroupLimits{processConfig.cgroup().memory(), processConfig.cgroup().cpu()});
+    }
+
+    // 配置变化的进程先停掉旧的
+    retireProcess(processConfig.process_name());
+
+    auto& group = groups_[processConfig.process_name()];
+    group.config = processConfig;
+    group.cgroup = std::move(cgroup);
+    group.parentCGroup = parentCGroup;
+    group.stdoutLog.reset();
+    group.stderrLog.reset();
+    if (!processConfig.stdout_logfile().empty()) {
+        group.stdoutLog = openOutputLog(processConfig.stdout_logfile(), processConfig.output_log());
+    }
+    if (!processConfig.redirect_stderr() && !processConfig.output_log().stderr_logfile().empty()) {
+        group.stderrLog = openOutputLog(processConfig.output_log().stderr_logfile(), processConfig.output_log());
+    }
+    // 先于启动副本开始监听，启动后马上 OOM 也能发现
+    if (ownsCGroup(group)) {
+        oom_->Watch(group.cgroup->name());
+    }
+
+    uint32_t numprocs = std::max<uint32_t>(processConfig.numprocs(), 1);
+    group.replicas.resize(numprocs);
+    group.states.clear();
+    for (uint32_t i = 0; i < numprocs; i++) {
+        group.states.emplace_back(processConfig.restart());
+    }
+    // 旧的副本还在停止时等它们退出再启动，新旧进程不会同时运行
+    group.waitRetired = hasRetired(processConfig.process_name());
+    if (!group.waitRetired) {
+        for (uint32_t i = 0; i < numprocs; i++) {
+            launch(group, i);
+        }
+    }
+
+    // 压力触发器只挂在进程组自己的 cgroup 上
+    if (processConfig.cgroup().enabled() && group.cgroup) {
+        for (auto& pressure : processConfig.pressure()) {
+            pressure_->Watch(processConfig.process_name(), group.cgroup->name(), pressure);
+        }
+    }
+}
+
+std::shared_ptr<OutputLog> Manager::openOutputLog(const std::string& path, const OutputLogConfig& config) {
+    auto& entry = outputLogs_[path];
+    auto log = entry.lock();
+    if (log) {
+        log->SetConfig(config);
+        return log;
+    }
+    log = std::make_shared<OutputLog>(path, config);
+    entry = log;
+    // 顺便清掉已经没有人用的
+    for (auto iter = outputLogs_.begin(); iter != outputLogs_.end();) {
+        if (iter->second.expired()) {
+            outputLogs_.erase(iter++);
+        } else {
+            ++iter;
+        }
+    }
+    return log;
+}
+
+std::shared_ptr<const OutputLog> Manager::findOutputLog(const std::string& name, bool errorStream) const {
+    auto iter = groups_.find(name);
+    if (iter == groups_.end()) {
+        return nullptr;
+    }
+    auto& group = iter->second;
+    if (errorStream && !group.config.redirect_stderr()) {
+        return group.stderrLog;
+    }
+    return group.stdoutLog;
+}
+
+std::string Manager::cgroupName(const ProcessConfig& processConfig) const {
+    // 开启了父层级 cgroup 时每个进程组的 cgroup 嵌套在它下面，和 createParentCGroup 的条件相同
+    auto snapshot = config_->Snapshot();
+    auto& parent = snapshot->cgroup();
+    if (!parent.enabled() || parent.name().empty()) {
+        return processConfig.process_name();
+    }
+    return parent.name() + "/" + processConfig.process_name();
+}
+
+void Manager::updatePartProcess(const std::vector<const ProcessConfig*>& processConfigs) {
+    for (auto* config : processConfigs) {
+        auto& processConfig = *config;
+        auto& name = processConfig.process_name();
+        auto iter = groups_.find(name);
+        if (iter == groups_.end()) {
+            continue;
+        }
+        auto& group = iter->second;
+        group.config = processConfig;
+        // 新的限额覆盖了限流
+        unthrottle(name, false);
+        if (processConfig.cgroup().enabled()) {
+            // 已经存在的 cgroup 只重写变化的限额，父层级先于嵌套在它下面的 cgroup 创建
+            group.parentCGroup = createParentCGroup();
+            group.cgroup = cgroups_.Acquire(cgroupName(processConfig), CGroupLimits{processConfig.cgroup().memory(),
+                                                                                    processConfig.cgroup().cpu()});
+        }
+        SPDLOG_INFO("process {} cgroup limits updated, memory={}, cpu={}", name, processConfig.cgroup().memory(),
+                    processConfig.cgroup().cpu());
+    }
+}
+
+void Manager::updateParentCGroup() {
+    auto snapshot = config_->Snapshot();
+    auto& config = snapshot->cgroup();
+    CGroupLimits applied;
+    if (!config.enabled() || config.name().empty() || !cgroups_.Limits(config.name(), &applied)) {
+        // 没有进程在用，下次启动时按新的限额创建
+        return;
+    }
+    // 父层级cgroup由使用它的进程组持有，重新获取时只重写变化的限额
+    createParentCGroup();
+    SPDLOG_INFO("parent cgroup {} limits updated, memory={}, cpu={}", config.name(), config.memory(), config.cpu());
+}
+
 void Manager::startProcessPool() {
     // start process
-    std::shared_ptr<OS::CGroup> cgroup;
-    if (config_->GetConfig().cgroup().enabled() && !config_->GetConfig().cgroup().name().empty()) {
-        cgroup = std::make_shared<OS::CGroup>(config_->GetConfig().cgroup().name());
-        cgroup->setCpuRate(config_->GetConfig().cgroup().cpu());
-        cgroup->setMemoryLimit(config_->GetConfig().cgroup().memory());
-        cgroup->run();
-    }
-    if (config_->GetConfig().service_size() > 0) {
-        auto iter = config_->GetConfig().service().begin();
-        for (; iter != config_->GetConfig().service().end(); iter++) {
-            auto process = std::make_unique<App::Process::Process>(iter->command(), loop);
-            if (iter->cgroup().enabled()) {
-                std::string cgroupName = config_->GetConfig().cgroup().name();
-                if (cgroupName.empty()) {
-                    cgroupName = iter->process_name();
-                }
-                auto processCGroup = std::make_shared<OS::CGroup>(cgroupName);
-                processCGroup->setMemoryLimit(iter->cgroup().memory());
-                processCGroup->setCpuRate(iter->cgroup().cpu());
-                process->setCGroup(processCGroup);
-            } else {
-                process->setCGroup(cgroup);
+    auto cgroup = createParentCGroup();
+    auto config = config_->Snapshot();
+    for (auto& processConfig : config->service()) {
+        startGroup(processConfig, cgroup);
+    }
+    armParentPressure();
+}
+
+void Manager::armParentPressure() {
+    pressure_->Unwatch(kParentOwner);
+    auto snapshot = config_->Snapshot();
+    auto& cgroup = snapshot->cgroup();
+    if (snapshot->pressure().empty()) {
+        return;
+    }
+    if (!cgroup.enabled() || cgroup.name().empty()) {
+        SPDLOG_WARN("pressure triggers need the parent cgroup, ignored");
+        return;
+    }
+    for (auto& pressure : snapshot->pressure()) {
+        pressure_->Watch(kParentOwner, cgroup.name(), pressure);
+    }
+}
+
+void Manager::onPressure(const std::string& owner, const PressureConfig& config) {
+    SPDLOG_WARN("{} pressure on {}, trigger \"{}\", action {}", PressureConfig::Resource_Name(config.resource()),
+                owner.empty() ? "manager" : owner, PressureMonitor::TriggerLine(config),
+                PressureConfig::Action_Name(config.action()));
+    if (stopping_ || config.action() == PressureConfig::ALERT) {
+        return;
+    }
+
+    // 没有指定 targets 时作用在触发的进程组自己身上，父层级cgroup只告警
+    std::vector<std::string> targets(config.targets().begin(), config.targets().end());
+    if (targets.empty() && owner != kParentOwner) {
+        targets.push_back(owner);
+    }
+    auto hold = config.hold_secs() > 0 ? std::chrono::seconds(config.hold_secs()) : kDefaultPressureHold;
+    for (auto& target : targets) {
+        auto iter = groups_.find(target);
+        if (iter == groups_.end() || !iter->second.cgroup || !iter->second.config.cgroup().enabled()) {
+            // 和别的进程组共用父层级cgroup的不能单独限流
+            SPDLOG_WARN("pressure target {} has no cgroup of its own, skipped", target);
+            continue;
+        }
+        if (config.action() == PressureConfig::THROTTLE) {
+            throttle(iter->second, config.throttle_cpu(), hold);
+        } else if (config.action() == PressureConfig::FREEZE) {
+            freeze(iter->second, hold);
+        }
+    }
+}
+
+void Manager::throttle(ProcessGroup& group, float cpu, std::chrono::seconds hold) {
+    auto& name = group.config.process_name();
+    if (cpu <= 0) {
+        SPDLOG_WARN("throttle_cpu of process {} is not set, skipped", name);
+        return;
+    }
+    auto iter = throttled_.find(name);
+    if (iter == throttled_.end()) {
+        CGroupLimits limits{group.config.cgroup().memory(), group.config.cgroup().cpu()};
+        if (limits.cpu > 0 && limits.cpu <= cpu) {
+            // 配置的限额已经更低
+            return;
+        }
+        limits.cpu = cpu;
+        if (!cgroups_.Update(group.cgroup->name(), limits)) {
+            return;
+        }
+        SPDLOG_WARN("process {} throttled to {} cpu for {}s", name, cpu, hold.count());
+        iter = throttled_.emplace(name, Core::Event::TimerWheel::kInvalidTimer).first;
+    } else {
+        // 压力还在，延长限流
+        timers_->Cancel(iter->second);
+    }
+    iter->second = timers_->Schedule(hold, [this, name]() { unthrottle(name, true); });
+}
+
+void Manager::freeze(ProcessGroup& group, std::chrono::seconds hold) {
+    auto& name = group.config.process_name();
+    auto iter = frozen_.find(name);
+    if (iter == frozen_.end()) {
+        if (!cgroups_.Freeze(group.cgroup->name(), true)) {
+            return;
+        }
+        SPDLOG_WARN("process {} frozen for {}s", name, hold.count());
+        iter = frozen_.emplace(name, Core::Event::TimerWheel::kInvalidTimer).first;
+    } else {
+        timers_->Cancel(iter->second);
+    }
+    iter->second = timers_->Schedule(hold, [this, name]() { thaw(name); });
+}
+
+void Manager::unthrottle(const std::string& name, bool restore) {
+    auto iter = throttled_.find(name);
+    if (iter == throttled_.end()) {
+        return;
+    }
+    timers_->Cancel(iter->second);
+    throttled_.erase(iter);
+    auto group = groups_.find(name);
+    if (!restore || group == groups_.end() || !group->second.cgroup) {
+        return;
+    }
+    auto& cgroup = group->second.config.cgroup();
+    cgroups_.Update(group->second.cgroup->name(), CGroupLimits{cgroup.memory(), cgroup.cpu()});
+    SPDLOG_INFO("process {} cpu limit restored to {}", name, cgroup.cpu());
+}
+
+void Manager::thaw(const std::string& name) {
+    auto iter = frozen_.find(name);
+    if (iter == frozen_.end()) {
+        return;
+    }
+    timers_->Cancel(iter->second);
+    frozen_.erase(iter);
+    auto group = groups_.find(name);
+    if (group != groups_.end() && group->second.cgroup) {
+        cgroups_.Freeze(group->second.cgroup->name(), false);
+        SPDLOG_INFO("process {} thawed", name);
+    }
+}
+
+void Manager::destroyPartProcess(const std::vector<std::string>& names) {
+    for (auto& name : names) {
+        retireProcess(name);
+    }
+}
+
+void Manager::destroyAllProcess() {
+    while (!groups_.empty()) {
+        retireProcess(groups_.begin()->first);
+    }
+}
+
+void Manager::retireProcess(const std::string& name) {
+    auto iter = groups_.find(name);
+    if (iter == groups_.end()) {
+        return;
+    }
+    for (auto& state : iter->second.states) {
+        cancelRestart(state);
+    }
+    pressure_->Unwatch(name);
+    if (ownsCGroup(iter->second)) {
+        oom_->Unwatch(iter->second.cgroup->name());
+    }
+    // 冻结的进程收不到停止信号；限额由新的进程组重新写
+    thaw(name);
+    unthrottle(name, false);
+    for (auto& process : iter->second.replicas) {
+        if (!process || !process->running()) {
+            continue;
+        }
+        // 运行中的进程退出后由 onProcessExit 删除
+        process->markRemoved();
+        process->stop();
+        const App::Process::Process* key = process.get();
+        retired_.emplace(key, std::move(process));
+    }
+    groups_.erase(iter);
+}
+
+bool Manager::hasRetired(const std::string& name) const {
+    for (auto& [ptr, process] : retired_) {
+        if (process->group() == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Manager::startPartProcess(const std::vector<const ProcessConfig*>& processConfigs) {
+    // start process
+    auto cgroup = createParentCGroup();
+    for (auto* processConfig : processConfigs) {
+        startGroup(*processConfig, cgroup);
+    }
+}
+
+ProcessGroup* Manager::findGroup(const std::string& name, int64_t* index) {
+    *index = -1;
+    auto iter = groups_.find(name);
+    if (iter != groups_.end()) {
+        return &iter->second;
+    }
+
+    // process_name:index
+    auto pos = name.rfind(':');
+    if (pos == std::string::npos || pos + 1 == name.size()) {
+        return nullptr;
+    }
+    char* end = nullptr;
+    auto value = strtoll(name.c_str() + pos + 1, &end, 10);
+    if (*end != '\0' || value < 0) {
+        return nullptr;
+    }
+    iter = groups_.find(name.substr(0, pos));
+    if (iter == groups_.end() || static_cast<size_t>(value) >= iter->second.replicas.size()) {
+        return nullptr;
+    }
+    *index = value;
+    return &iter->second;
+}
+
+void Manager::startProcess(const std::string &name) {
+    int64_t index;
+    auto group = findGroup(name, &index);
+    if (!group) {
+        // 进程组还没有创建
+        auto config = config_->Snapshot();
+        for (auto& processConfig : config->service()) {
+            if (processConfig.process_name() == name) {
+                startGroup(processConfig, createParentCGroup());
+                return;
             }
-            process->setName(iter->process_name());
-            process->execute();
-            Core::Component::Process::Manager::addProcess(std::move(process));
         }
+        SPDLOG_WARN("process {} not found", name);
+        return;
+    }
+
+    if (group->waitRetired) {
+        SPDLOG_INFO("process {} starts after its old replicas exited", name);
+        return;
+    }
+    for (uint32_t i = 0; i < group->replicas.size(); i++) {
+        if (index >= 0 && i != index) {
+            continue;
+        }
+        auto& process = group->replicas[i];
+        if (process && process->running()) {
+            SPDLOG_INFO("process {} is already running", process->name());
+            continue;
+        }
+        // 手动启动，FATAL 的进程重新计算重启次数
+        group->states[i].backoff.Reset();
+        launch(*group, i);
     }
 }
 
-void Manager::destroyPartProcess(const std::map<std::string, ProcessConfig> &processConfMap) {
-    auto& processes = this->all();
-    if (processes.empty()) {
+void Manager::stopProcess(const std::string &name) {
+    int64_t index;
+    auto group = findGroup(name, &index);
+    if (!group) {
+        SPDLOG_WARN("process {} not found", name);
         return;
     }
-    std::map<std::string, Core::Component::Process::Process*> processMap;
-    for (auto iter = processes.begin(); iter != processes.end(); iter++) {
-        processMap[iter->second->name()] = iter->second.get();;
+    if (index < 0) {
+        // 还在等旧副本退出的不再启动
+        group->waitRetired = false;
+    }
+    for (uint32_t i = 0; i < group->replicas.size(); i++) {
+        if (index >= 0 && i != index) {
+            continue;
+        }
+        cancelRestart(group->states[i]);
+        if (group->replicas[i]) {
+            group->replicas[i]->stop();
+        }
+    }
+}
+
+void Manager::launch(ProcessGroup& group, uint32_t index) {
+    const auto& processConfig = group.config;
+    auto process = std::make_unique<App::Process::Process>(processConfig.command(), loop, timers_.get());
+    process->setName(processConfig.process_name(), index, group.replicas.size());
+    process->setCommandLine(config_->GetCommandLine(processConfig.process_name()));
+    int stopSignal = static_cast<int>(processConfig.stopsignal());
+    if (stopSignal <= 0 || stopSignal >= NSIG) {
+        stopSignal = SIGTERM;
     }
+    auto stopWait = processConfig.stopwaitsecs() > 0 ? std::chrono::seconds(processConfig.stopwaitsecs())
+                                                     : kDefaultStopWait;
+    process->setStopPolicy(stopSignal, stopWait, processConfig.stopasgroup());
+    if (group.cgroup) {
+        process->setCGroup(group.cgroup);
+    }
+    process->setOutput(group.stdoutLog, group.stderrLog, processConfig.redirect_stderr());
+
+    auto& state = group.states[index];
+    cancelRestart(state);
+    process->setRestarts(state.backoff.restarts());
+    process->setOomKills(state.oomKills);
+
+    auto begin = std::chrono::steady_clock::now();
+    int pidfd = -1;
+    bool started = process->execute(*spawner_, &pidfd);
+    spawnLatency_.Record(std::chrono::steady_clock::now() - begin);
+    if (started) {
+        children_->watch(process.get(), pidfd);
+    }
+    group.replicas[index] = std::move(process);
+    if (!started) {
+        scheduleRestart(group, index);
+    }
+}
 
-    for (auto iter = processConfMap.begin(); iter != processConfMap.end(); iter++) {
-        auto processIter = processMap.find(iter->first);
-        if (processIter == processMap.end()) {
+void Manager::scheduleRestart(ProcessGroup& group, uint32_t index) {
+    auto& process = *group.replicas[index];
+    auto& state = group.states[index];
+    // 启动失败时没有退出状态，按失败处理
+    int status = process.getPid() > 0 ? process.exitStatus() : W_EXITCODE(127, 0);
+    auto uptime = std::chrono::seconds(process.getPid() > 0 ? time(nullptr) - process.getStartTime() : 0);
+    std::chrono::milliseconds delay{0};
+    switch (state.backoff.OnExit(status, process.oomKilled(), uptime, std::chrono::steady_clock::now(), &delay)) {
+    case RestartBackoff::Decision::kStop:
+        return;
+    case RestartBackoff::Decision::kFatal:
+        if (state.backoff.oomStreak() > 0) {
+            SPDLOG_ERROR("process {} keeps running out of memory, give up, oom_kills={}", process.name(),
+                         state.backoff.oomStreak());
+        } else {
+            SPDLOG_ERROR("process {} restarted too often, give up", process.name());
+        }
+        process.markFatal();
+        return;
+    case RestartBackoff::Decision::kRestart:
+        break;
+    }
+
+    SPDLOG_INFO("restart process {} in {}ms, restarts={}", process.name(), delay.count(), state.backoff.restarts());
+    process.markBackoff(delay);
+    state.restartTimer = timers_->Schedule(delay, [this, name = group.config.process_name(), index]() {
+        auto iter = groups_.find(name);
+        if (stopping_ || iter == groups_.end()) {
+            return;
+        }
+        iter->second.states[index].restartTimer = Core::Event::TimerWheel::kInvalidTimer;
+        launch(iter->second, index);
+    });
+}
+
+void Manager::cancelRestart(ReplicaState& state) {
+    timers_->Cancel(state.restartTimer);
+    state.restartTimer = Core::Event::TimerWheel::kInvalidTimer;
+}
+
+bool Manager::ownsCGroup(const ProcessGroup& group) {
+    return group.cgroup && group.config.cgroup().enabled();
+}
+
+void Manager::onOom(const std::string& cgroup, const OomCounts& delta) {
+    auto now = std::chrono::steady_clock::now();
+    // 进程组自己的 cgroup 嵌套在父层级下，名字里有 process_name，最多对应一个进程组
+    for (auto& [name, group] : groups_) {
+        if (!ownsCGroup(group) || group.cgroup->name() != cgroup) {
             continue;
         }
-        processIter->second->remove();
-    }
-}
-
-void Manager::startPartProcess(const std::map<std::string, ProcessConfig> &processConfMap) {
-// start process
-    std::shared_ptr<OS::CGroup> cgroup;
-    if (config_->GetConfig().cgroup().enabled() && !config_->GetConfig().cgroup().name().empty()) {
-        cgroup = std::make_shared<OS::CGroup>(config_->GetConfig().cgroup().name());
-        cgroup->setCpuRate(config_->GetConfig().cgroup().cpu());
-        cgroup->setMemoryLimit(config_->GetConfig().cgroup().memory());
-        cgroup->run();
-    }
-    if (!processConfMap.empty()) {
-        auto iter = processConfMap.begin();
-        for (; iter != processConfMap.end(); iter++) {
-            auto process = std::make_unique<App::Process::Process>(iter->second.command(), loop);
-            if (iter->second.cgroup().enabled()) {
-                std::string cgroupName = config_->GetConfig().cgroup().name();
-                if (cgroupName.empty()) {
-                    cgroupName = iter->second.process_name();
-                }
-                auto processCGroup = std::make_shared<OS::CGroup>(cgroupName);
-                processCGroup->setMemoryLimit(iter->second.cgroup().memory());
-                processCGroup->setCpuRate(iter->second.cgroup().cpu());
-                processCGroup->run();
-            } else {
-                process->setCGroup(cgroup);
+        group.oom.oom += delta.oom;
+        group.oom.oomKill += delta.oomKill;
+        if (delta.oomKill > 0) {
+            // 太久以前的 oom_kill 杀的不是副本本身，不再对应
+            if (now - group.lastOomKill > kOomAttribution) {
+                group.pendingOomKills = 0;
             }
-            process->setName(iter->second.process_name());
-            process->execute();
-            Core::Component::Process::Manager::addProcess(std::move(process));
+            group.pendingOomKills += delta.oomKill;
+            group.lastOomKill = now;
         }
+        SPDLOG_WARN("process {} hit the memory limit of cgroup {}, oom={}, oom_kill={}", name, cgroup, delta.oom,
+                    delta.oomKill);
+        return;
     }
 }
 
-void Manager::startProcess(const std::string &name) {
-  // start process
-  std::shared_ptr<OS::CGroup> cgroup;
-  if (config_->GetConfig().cgroup().enabled() && !config_->GetConfig().cgroup().name().empty()) {
-    cgroup = std::make_shared<OS::CGroup>(config_->GetConfig().cgroup().name());
-    cgroup->setCpuRate(config_->GetConfig().cgroup().cpu());
-    cgroup->setMemoryLimit(config_->GetConfig().cgroup().memory());
-    cgroup->run();
-  }
-
-  if (config_->GetConfig().service_size() > 0) {
-    for (auto iter = config_->GetConfig().service().begin(); iter != config_->GetConfig().service().end(); iter++) {
-      if (iter->process_name() != name) continue;
-      auto process = std::make_unique<App::Process::Process>(iter->command(), loop);
-      if (iter->cgroup().enabled()) {
-        std::string cgroupName = config_->GetConfig().cgroup().name();
-        if (cgroupName.empty()) {
-          cgroupName = iter->process_name();
-        }
-        auto processCGroup = std::make_shared<OS::CGroup>(cgroupName);
-        processCGroup->setMemoryLimit(iter->cgroup().memory());
-        processCGroup->setCpuRate(iter->cgroup().cpu());
-        process->setCGroup(processCGroup);
-      } else {
-        process->setCGroup(cgroup);
-      }
-      process->setName(iter->process_name());
-      process->execute();
-      Core::Component::Process::Manager::addProcess(std::move(process));
-    }
-  }
+bool Manager::takeOomKill(ProcessGroup& group, App::Process::Process& process) {
+    int status = process.exitStatus();
+    if (!ownsCGroup(group) || !WIFSIGNALED(status) || WTERMSIG(status) != SIGKILL) {
+        return false;
+    }
+    // 退出可能先于 inotify 通知到达，直接读一次 memory.events；oom_kill 没有增加时是别的原因的 SIGKILL
+    oom_->Check(group.cgroup->name());
+    if (group.pendingOomKills == 0 || std::chrono::steady_clock::now() - group.lastOomKill > kOomAttribution) {
+        return false;
+    }
+    group.pendingOomKills--;
+    process.markOomKilled();
+    group.states[process.index()].oomKills = process.oomKills();
+    SPDLOG_ERROR("process {} was killed by the OOM killer of cgroup {}, oom_kills={}", process.name(),
+                 group.cgroup->name(), process.oomKills());
+    return true;
+}
+
+void Manager::onProcessExit(App::Process::Process& process) {
+    if (process.removed()) {
+        std::string name = process.group();
+        retired_.erase(&process);
+        // 旧副本都退出后启动等待中的新副本
+        auto iter = groups_.find(name);
+        if (!stopping_ && iter != groups_.end() && iter->second.waitRetired && !hasRetired(name)) {
+            iter->second.waitRetired = false;
+            for (uint32_t i = 0; i < iter->second.replicas.size(); i++) {
+                launch(iter->second, i);
+            }
+        }
+    } else if (!stopping_ && process.getStatus() == ProcessStatus::EXITED) {
+        auto iter = groups_.find(process.group());
+        if (iter != groups_.end() && iter->second.replicas[process.index()].get() == &process) {
+            takeOomKill(iter->second, process);
+            scheduleRestart(iter->second, process.index());
+        }
+    }
+    if (stopping_) {
+        quitIfIdle();
+    }
 }
 }
 }
@@ -0,0 +1,70 @@
+#include "process/metrics.h"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <prometheus/text_serializer.h>
+
+namespace App::Process {
+prometheus::MetricFamily MakeFamily(std::string name, std::string help, prometheus::MetricType type) {
+  prometheus::MetricFamily family;
+  family.name = std::move(name);
+  family.help = std::move(help);
+  family.type = type;
+  return family;
+}
+
+void AddSample(prometheus::MetricFamily &family, double value, MetricLabels labels) {
+  prometheus::ClientMetric metric;
+  metric.label = std::move(labels);
+  switch (family.type) {
+  case prometheus::MetricType::Counter:
+    metric.counter.value = value;
+    break;
+  case prometheus::MetricType::Gauge:
+    metric.gauge.value = value;
+    break;
+  default:
+    metric.untyped.value = value;
+    break;
+  }
+  family.metric.push_back(std::move(metric));
+}
+
+void AddHistogram(prometheus::MetricFamily &family, const LatencyHistogram &histogram, MetricLabels labels) {
+  prometheus::ClientMetric metric;
+  metric.label = std::move(labels);
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < LatencyHistogram::kBuckets; i++) {
+    cumulative += histogram.Bucket(i);
+    prometheus::ClientMetric::Bucket bucket;
+    bucket.cumulative_count = cumulative;
+    bucket.upper_bound = i + 1 < LatencyHistogram::kBuckets ? LatencyHistogram::UpperBoundMicros(i) / 1e6
+                                                            : std::numeric_limits<double>::infinity();
+    metric.histogram.bucket.push_back(bucket);
+  }
+  // the buckets and the count are read one after another, keep them consistent for the scraper
+  metric.histogram.sample_count = cumulative;
+  metric.histogram.sample_sum = histogram.SumMicros() / 1e6;
+  family.metric.push_back(std::move(metric));
+}
+
+void MetricsRegistry::Register(const std::shared_ptr<prometheus::Collectable> &source) {
+  sources_.push_back(source);
+}
+
+std::string MetricsRegistry::Serialize() {
+  std::vector<prometheus::MetricFamily> families;
+  sources_.erase(std::remove_if(sources_.begin(), sources_.end(),
+                                [&families](const std::weak_ptr<prometheus::Collectable> &weak) {
+                                  auto source = weak.lock();
+                                  if (!source) {
+                                    return true;
+                                  }
+                                  auto collected = source->Collect();
+                                  std::move(collected.begin(), collected.end(), std::back_inserter(families));
+                                  return false;
+                                }),
+                 sources_.end());
+  return prometheus::TextSerializer().Serialize(families);
+}
+} // namespace App::Process
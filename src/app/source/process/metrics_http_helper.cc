@@ -0,0 +1,26 @@
+#include "process/metrics_http_helper.h"
+
+#include "http/http_request.h"
+#include "http/http_action.h"
+#include "http/http_manager.h"
+#include "http/http_router.h"
+
+namespace App {
+namespace Process {
+void MetricsHttpHelper::bind() {
+    std::shared_ptr<Core::Http::HttpAction> action = std::make_shared<Core::Http::HttpAction>();
+
+    //绑定action
+    action->setUsers(std::bind(&MetricsHttpHelper::handle, shared_from_this(), _1, _2));
+
+    //注入路由
+    manager_->getRouter()->getRequest(path, action);
+}
+
+void MetricsHttpHelper::handle(Core::Http::HttpRequest &/*request*/, Core::Http::HttpResponse &response) {
+    response.header("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+    response.response(200, registry_->Serialize());
+}
+
+}
+}
@@ -0,0 +1,151 @@
+#include "process/oom_watcher.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "process/cgroup_registry.h"
+#include "process/cgroup_stats.h"
+
+namespace App::Process {
+namespace {
+// memory.events has six short lines
+constexpr size_t kReadBuffer = 512;
+} // namespace
+
+OomWatcher::Entry::~Entry() {
+  if (fd != -1) {
+    close(fd);
+  }
+}
+
+void OomWatcher::EventFn(evutil_socket_t, short, void *handler) { static_cast<OomWatcher *>(handler)->OnReadable(); }
+
+OomWatcher::OomWatcher(Core::Event::EventLoop *loop, Callback callback)
+    : loop_(loop), callback_(std::move(callback)) {
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ == -1) {
+    SPDLOG_ERROR("Failed to create inotify fd, errno={}, message={}", errno, strerror(errno));
+    throw std::runtime_error("Failed to create inotify fd");
+  }
+
+  event *ev = event_new(loop_->getEventBase(), inotify_fd_, EV_READ | EV_PERSIST, EventFn, this);
+  if (ev == nullptr) {
+    SPDLOG_ERROR("Failed to create event");
+    throw std::runtime_error("Failed to create event");
+  }
+  event_.Reset(ev);
+  event_add(ev, nullptr);
+}
+
+OomWatcher::~OomWatcher() {
+  event_del(event_.get());
+  entries_.clear();
+  close(inotify_fd_);
+}
+
+bool OomWatcher::Watch(const std::string &cgroup) {
+  auto iter = entries_.find(cgroup);
+  if (iter != entries_.end()) {
+    iter->second->refs++;
+    return true;
+  }
+
+  std::string path = CGroupRegistry::ControlPath(cgroup, "memory", "memory.events");
+  auto entry = std::make_unique<Entry>();
+  entry->cgroup = cgroup;
+  entry->fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (entry->fd == -1) {
+    // cgroup v1, or the memory controller is not enabled for the cgroup
+    SPDLOG_WARN("open {} failed, OOM kills of {} will not be detected, errno={}, message={}", path, cgroup, errno,
+                strerror(errno));
+    return false;
+  }
+  entry->wd = inotify_add_watch(inotify_fd_, path.c_str(), IN_MODIFY);
+  if (entry->wd == -1) {
+    SPDLOG_ERROR("inotify_add_watch {} failed, errno={}, message={}", path, errno, strerror(errno));
+    return false;
+  }
+  Read(*entry, &entry->last);
+  entry->refs = 1;
+  wds_[entry->wd] = entry.get();
+  entries_[cgroup] = std::move(entry);
+  return true;
+}
+
+void OomWatcher::Unwatch(const std::string &cgroup) {
+  auto iter = entries_.find(cgroup);
+  if (iter == entries_.end() || --iter->second->refs > 0) {
+    return;
+  }
+  if (iter->second->wd != -1) {
+    inotify_rm_watch(inotify_fd_, iter->second->wd);
+    wds_.erase(iter->second->wd);
+  }
+  entries_.erase(iter);
+}
+
+void OomWatcher::Check(const std::string &cgroup) {
+  auto iter = entries_.find(cgroup);
+  if (iter != entries_.end()) {
+    Update(*iter->second);
+  }
+}
+
+bool OomWatcher::Read(const Entry &entry, OomCounts *counts) {
+  char buffer[kReadBuffer];
+  ssize_t n = pread(entry.fd, buffer, sizeof(buffer), 0);
+  if (n <= 0) {
+    return false;
+  }
+  CGroupSample sample;
+  CGroupStats::ParseMemoryEvents(std::string_view(buffer, n), &sample);
+  counts->oom = sample.oom;
+  counts->oomKill = sample.oomKill;
+  return true;
+}
+
+void OomWatcher::Update(Entry &entry) {
+  OomCounts counts;
+  if (!Read(entry, &counts)) {
+    return;
+  }
+  OomCounts delta;
+  delta.oom = counts.oom > entry.last.oom ? counts.oom - entry.last.oom : 0;
+  delta.oomKill = counts.oomKill > entry.last.oomKill ? counts.oomKill - entry.last.oomKill : 0;
+  entry.last = counts;
+  if (delta.oom > 0 || delta.oomKill > 0) {
+    callback_(entry.cgroup, delta);
+  }
+}
+
+void OomWatcher::OnReadable() {
+  alignas(inotify_event) char buffer[4096];
+  for (;;) {
+    ssize_t n = read(inotify_fd_, buffer, sizeof(buffer));
+    if (n <= 0) {
+      break;
+    }
+    for (char *p = buffer; p < buffer + n;) {
+      auto event = reinterpret_cast<inotify_event *>(p);
+      p += sizeof(inotify_event) + event->len;
+      notifications_++;
+      auto iter = wds_.find(event->wd);
+      if (iter == wds_.end()) {
+        continue;
+      }
+      if (event->mask & IN_IGNORED) {
+        // the kernel dropped the watch
+        iter->second->wd = -1;
+        wds_.erase(iter);
+        continue;
+      }
+      // the callback may unwatch, look the entry up for every event
+      Update(*iter->second);
+    }
+  }
+}
+} // namespace App::Process
@@ -0,0 +1,247 @@
+#include "process/output_log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace App::Process {
+namespace {
+// bytes taken from a pipe per wakeup, the loop gets back to other events in between
+constexpr size_t kDrainChunk = 1024 * 1024;
+} // namespace
+
+OutputLog::OutputLog(std::string path, const OutputLogConfig &config)
+    : path_(std::move(path)), refilled_(std::chrono::steady_clock::now()) {
+  SetConfig(config);
+  tokens_ = static_cast<double>(rate_);
+  Open();
+  if (pipe2(tailPipe_, O_CLOEXEC | O_NONBLOCK) == -1) {
+    SPDLOG_WARN("create tail pipe of {} failed, errno={}, message={}", path_, errno, strerror(errno));
+  } else {
+    // tee() copies at most what fits, as much as one drain takes
+    fcntl(tailPipe_[1], F_SETPIPE_SZ, static_cast<int>(kDrainChunk));
+  }
+}
+
+void OutputLog::SetConfig(const OutputLogConfig &config) {
+  maxBytes_ = config.max_bytes() > 0 ? config.max_bytes() : kDefaultMaxBytes;
+  backups_ = config.backups() > 0 ? config.backups() : kDefaultBackups;
+  rotateAge_ = std::chrono::seconds(config.rotate_secs());
+  rate_ = config.rate_bytes();
+  size_t capacity = config.tail_kb() > 0 ? config.tail_kb() * 1024ull : TailBuffer::kDefaultCapacity;
+  if (!tail_ || std::min(capacity, TailBuffer::kMaxCapacity) != tail_->capacity()) {
+    auto tail = std::make_unique<TailBuffer>(capacity);
+    if (tail_) {
+      // keep the history, as much of it as fits; it is marked with the time of the copy
+      std::string kept;
+      tail_->Read(0, &kept);
+      size_t skip = kept.size() > tail->capacity() ? kept.size() - tail->capacity() : 0;
+      tail->Append(kept.data() + skip, kept.size() - skip);
+    }
+    tail_ = std::move(tail);
+  }
+}
+
+OutputLog::~OutputLog() {
+  for (int fd : {fd_, tailPipe_[0], tailPipe_[1]}) {
+    if (fd != -1) {
+      close(fd);
+    }
+  }
+}
+
+int OutputLog::NullFd() {
+  static const int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  return fd;
+}
+
+bool OutputLog::Open() {
+  opening_ = time(nullptr);
+  // no O_APPEND, splice refuses it
+  fd_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ == -1) {
+    // retried by Drain, logged once until it works again
+    if (!openFailed_) {
+      SPDLOG_ERROR("open {} failed, output is dropped until it can be opened, errno={}, message={}", path_, errno,
+                   strerror(errno));
+    }
+    openFailed_ = true;
+    return false;
+  }
+  if (openFailed_) {
+    SPDLOG_INFO("{} opened again", path_);
+    openFailed_ = false;
+  }
+  struct stat st {};
+  fstat(fd_, &st);
+  offset_ = st.st_size;
+  opened_ = time(nullptr);
+  return true;
+}
+
+void OutputLog::Rotate() {
+  if (fd_ != -1) {
+    close(fd_);
+    fd_ = -1;
+  }
+  for (uint32_t i = backups_; i > 1; i--) {
+    auto from = path_ + "." + std::to_string(i - 1);
+    auto to = path_ + "." + std::to_string(i);
+    if (rename(from.c_str(), to.c_str()) == -1 && errno != ENOENT) {
+      SPDLOG_WARN("rename {} to {} failed, errno={}, message={}", from, to, errno, strerror(errno));
+    }
+  }
+  auto first = path_ + ".1";
+  if (rename(path_.c_str(), first.c_str()) == -1 && errno != ENOENT) {
+    SPDLOG_WARN("rename {} to {} failed, errno={}, message={}", path_, first, errno, strerror(errno));
+  }
+  rotations_++;
+  Open();
+}
+
+size_t OutputLog::Take(size_t n) {
+  if (rate_ == 0) {
+    return n;
+  }
+  // the bucket holds one second of output
+  auto now = std::chrono::steady_clock::now();
+  double elapsed = std::chrono::duration<double>(now - refilled_).count();
+  refilled_ = now;
+  tokens_ = std::min(static_cast<double>(rate_), tokens_ + elapsed * static_cast<double>(rate_));
+  size_t allowed = std::min(n, static_cast<size_t>(tokens_));
+  tokens_ -= static_cast<double>(allowed);
+  return allowed;
+}
+
+ssize_t OutputLog::Discard(int pipe, size_t n) {
+  ssize_t moved = splice(pipe, nullptr, NullFd(), nullptr, n, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  if (moved > 0) {
+    dropped_ += moved;
+  }
+  return moved;
+}
+
+size_t OutputLog::Tee(int pipe, size_t n) {
+  ssize_t copied = tee(pipe, tailPipe_[1], n, SPLICE_F_NONBLOCK);
+  if (copied <= 0) {
+    return 0;
+  }
+  size_t taken = 0;
+  while (taken < static_cast<size_t>(copied)) {
+    ssize_t count = tail_->Fill(tailPipe_[0], copied - taken);
+    if (count <= 0) {
+      break;
+    }
+    taken += count;
+  }
+  return copied;
+}
+
+ssize_t OutputLog::Drain(int pipe) {
+  int available = 0;
+  if (ioctl(pipe, FIONREAD, &available) == -1) {
+    return -1;
+  }
+  if (available == 0) {
+    // readable but empty: every writer closed its end
+    return 0;
+  }
+  size_t wanted = std::min<size_t>(available, kDrainChunk);
+  if (tailPipe_[1] != -1) {
+    // take only what made it into the tail, the rest stays in the pipe for the next round
+    size_t copied = Tee(pipe, wanted);
+    if (copied > 0) {
+      wanted = copied;
+    }
+  }
+
+  if (fd_ == -1 && time(nullptr) != opening_) {
+    // the open failed at start or at the last rotation, try again at most once a second
+    Open();
+  }
+  if (fd_ != -1 && offset_ > 0 &&
+      (offset_ + static_cast<off64_t>(wanted) > static_cast<off64_t>(maxBytes_) ||
+       (rotateAge_.count() > 0 && time(nullptr) - opened_ >= rotateAge_.count()))) {
+    Rotate();
+  }
+
+  size_t allowed = fd_ == -1 ? 0 : Take(wanted);
+  size_t moved = 0;
+  while (moved < allowed) {
+    ssize_t n = splice(pipe, nullptr, fd_, &offset_, allowed - moved, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n <= 0) {
+      if (n == -1 && errno != EAGAIN) {
+        SPDLOG_ERROR("splice to {} failed, errno={}, message={}", path_, errno, strerror(errno));
+      }
+      break;
+    }
+    moved += n;
+    written_ += n;
+  }
+  // over the rate, or the file could not take it: the writer must not block on a full pipe
+  if (moved < wanted) {
+    ssize_t n = Discard(pipe, wanted - moved);
+    if (n > 0) {
+      moved += n;
+    }
+  }
+  if (moved == 0) {
+    errno = EAGAIN;
+    return -1;
+  }
+  return static_cast<ssize_t>(moved);
+}
+
+void OutputCapture::EventFn(evutil_socket_t, short, void *handler) {
+  static_cast<OutputCapture *>(handler)->OnReadable();
+}
+
+OutputCapture::OutputCapture(Core::Event::EventLoop *loop, int pipe, std::shared_ptr<OutputLog> log)
+    : pipe_(pipe), log_(std::move(log)) {
+  event *ev = event_new(loop->getEventBase(), pipe_, EV_READ | EV_PERSIST, EventFn, this);
+  if (ev == nullptr) {
+    SPDLOG_ERROR("Failed to create event");
+    throw std::runtime_error("Failed to create event");
+  }
+  event_.Reset(ev);
+  event_add(ev, nullptr);
+}
+
+OutputCapture::~OutputCapture() {
+  if (pipe_ != -1) {
+    // only about what is buffered now, a writer that is still running must not keep us here
+    int size = fcntl(pipe_, F_GETPIPE_SZ);
+    ssize_t left = size > 0 ? size : static_cast<ssize_t>(kDrainChunk);
+    while (left > 0) {
+      ssize_t n = log_->Drain(pipe_);
+      if (n <= 0) {
+        break;
+      }
+      left -= n;
+    }
+  }
+  Close();
+}
+
+void OutputCapture::OnReadable() {
+  ssize_t n = log_->Drain(pipe_);
+  if (n == 0 || (n == -1 && errno != EAGAIN)) {
+    Close();
+  }
+}
+
+void OutputCapture::Close() {
+  if (pipe_ == -1) {
+    return;
+  }
+  event_del(event_.get());
+  close(pipe_);
+  pipe_ = -1;
+}
+} // namespace App::Process
@@ -0,0 +1,201 @@
+#include "process/pressure_monitor.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "process/cgroup_registry.h"
+
+namespace App::Process {
+namespace {
+// window_ms not configured
+constexpr uint32_t kDefaultWindowMs = 1000;
+// events taken from epoll per wakeup, the rest stays for the next round
+constexpr int kMaxEvents = 32;
+// pressure events are rare, the queue only has to take a burst of all triggers at once
+constexpr size_t kQueueCapacity = 64;
+constexpr uint64_t kWakeId = 0;
+} // namespace
+
+PressureMonitor::Trigger::~Trigger() {
+  if (fd != -1) {
+    close(fd);
+  }
+}
+
+PressureMonitor::PressureMonitor(Core::Event::EventLoop *loop, Callback callback)
+    : callback_(std::move(callback)), queue_(loop, kQueueCapacity) {
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ == -1) {
+    SPDLOG_ERROR("Failed to create epoll fd, errno={}, message={}", errno, strerror(errno));
+    throw std::runtime_error("Failed to create epoll fd");
+  }
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wake_fd_ == -1) {
+    SPDLOG_ERROR("Failed to create event fd");
+    throw std::runtime_error("Failed to create event fd");
+  }
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.u64 = kWakeId;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+}
+
+PressureMonitor::~PressureMonitor() {
+  if (waiter_.joinable()) {
+    uint64_t one = 1;
+    write(wake_fd_, &one, sizeof(one));
+    waiter_.join();
+  }
+  // the kernel drops closed fds from the epoll set
+  triggers_.clear();
+  close(wake_fd_);
+  close(epoll_fd_);
+}
+
+std::string PressureMonitor::PressurePath(const std::string &cgroup, PressureConfig::Resource resource) {
+  if (resource == PressureConfig::MEMORY) {
+    return CGroupRegistry::ControlPath(cgroup, "memory", "memory.pressure");
+  }
+  if (resource == PressureConfig::IO) {
+    return CGroupRegistry::ControlPath(cgroup, "blkio", "io.pressure");
+  }
+  return CGroupRegistry::ControlPath(cgroup, "cpu", "cpu.pressure");
+}
+
+std::string PressureMonitor::TriggerLine(const PressureConfig &config, bool unprivileged) {
+  uint32_t window = config.window_ms() > 0 ? config.window_ms() : kDefaultWindowMs;
+  if (unprivileged) {
+    window = (window + kUnprivilegedWindowMs - 1) / kUnprivilegedWindowMs * kUnprivilegedWindowMs;
+  }
+  window = std::clamp(window, kMinWindowMs, kMaxWindowMs);
+  // stall_ms not configured: 10% of the window
+  uint32_t stall = config.stall_ms() > 0 ? std::min(config.stall_ms(), window) : window / 10;
+  // the kernel takes microseconds
+  return std::string(config.full() ? "full " : "some ") + std::to_string(stall * 1000ull) + " " +
+         std::to_string(window * 1000ull);
+}
+
+bool PressureMonitor::Watch(const std::string &owner, const std::string &cgroup, const PressureConfig &config) {
+  auto path = PressurePath(cgroup, config.resource());
+  int fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd == -1) {
+    // no such file on cgroup v1 or without CONFIG_PSI
+    SPDLOG_ERROR("open {} failed, errno={}, message={}", path, errno, strerror(errno));
+    return false;
+  }
+  auto trigger = std::make_unique<Trigger>();
+  trigger->id = next_id_++;
+  trigger->owner = owner;
+  trigger->cgroup = cgroup;
+  trigger->config = config;
+  trigger->fd = fd;
+
+  // the trigger line must be written in one go including the terminating zero
+  auto line = TriggerLine(config);
+  bool armed = write(fd, line.c_str(), line.size() + 1) != -1;
+  if (!armed && errno == EINVAL) {
+    // EINVAL for a window the kernel only grants with CAP_SYS_RESOURCE, e.g. inside a container
+    auto rounded = TriggerLine(config, true);
+    if (rounded != line) {
+      SPDLOG_WARN("pressure trigger \"{}\" refused by {}, retry with \"{}\"", line, path, rounded);
+      line = rounded;
+      armed = write(fd, line.c_str(), line.size() + 1) != -1;
+    }
+  }
+  if (!armed) {
+    SPDLOG_ERROR("write {} to {} failed, errno={}, message={}", line, path, errno, strerror(errno));
+    return false;
+  }
+
+  // edge triggered: the fd of a removed cgroup reports EPOLLERR once instead of on every wait
+  epoll_event ev{};
+  ev.events = EPOLLPRI | EPOLLET;
+  ev.data.u64 = trigger->id;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+    SPDLOG_ERROR("epoll_ctl {} failed, errno={}, message={}", path, errno, strerror(errno));
+    return false;
+  }
+  if (!waiter_.joinable()) {
+    waiter_ = std::thread([this]() { Wait(); });
+  }
+  SPDLOG_INFO("pressure trigger \"{}\" armed on {} for {}", line, path, owner.empty() ? "manager" : owner);
+  ids_[trigger->id] = trigger.get();
+  triggers_[owner].push_back(std::move(trigger));
+  return true;
+}
+
+void PressureMonitor::Unwatch(const std::string &owner) {
+  auto iter = triggers_.find(owner);
+  if (iter == triggers_.end()) {
+    return;
+  }
+  for (auto &trigger : iter->second) {
+    ids_.erase(trigger->id);
+  }
+  // closing the fds removes them from the epoll set
+  triggers_.erase(iter);
+}
+
+void PressureMonitor::Remove(uint64_t id) {
+  auto trigger = ids_.find(id);
+  if (trigger == ids_.end()) {
+    return;
+  }
+  auto iter = triggers_.find(trigger->second->owner);
+  ids_.erase(trigger);
+  auto &triggers = iter->second;
+  triggers.erase(std::remove_if(triggers.begin(), triggers.end(),
+                                [id](const std::unique_ptr<Trigger> &item) { return item->id == id; }),
+                 triggers.end());
+  if (triggers.empty()) {
+    triggers_.erase(iter);
+  }
+}
+
+void PressureMonitor::Wait() {
+  epoll_event events[kMaxEvents];
+  for (;;) {
+    int n = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n == -1) {
+      SPDLOG_ERROR("epoll_wait failed, errno={}, message={}", errno, strerror(errno));
+      return;
+    }
+    for (int i = 0; i < n; i++) {
+      uint64_t id = events[i].data.u64;
+      if (id == kWakeId) {
+        return;
+      }
+      bool error = events[i].events & EPOLLERR;
+      // only the id crosses threads, the trigger may be gone by the time the task runs
+      queue_.Push([this, id, error]() { Dispatch(id, error); }, Core::Event::TaskPriority::kControl);
+    }
+  }
+}
+
+void PressureMonitor::Dispatch(uint64_t id, bool error) {
+  auto iter = ids_.find(id);
+  if (iter == ids_.end()) {
+    return;
+  }
+  auto trigger = iter->second;
+  if (error) {
+    SPDLOG_WARN("pressure trigger on {} is gone", trigger->cgroup);
+    Remove(id);
+    return;
+  }
+  trigger->events++;
+  // the callback may unwatch the owner
+  auto owner = trigger->owner;
+  auto config = trigger->config;
+  callback_(owner, config);
+}
+} // namespace App::Process
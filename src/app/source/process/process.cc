@@ -0,0 +1,210 @@
+#include "process/process.h"
+
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "process/child_watcher.h"
+#include "process/output_log.h"
+#include "process/spawner.h"
+
+namespace App {
+namespace Process {
+// 输出管道的大小，watchermen 忙的时候子进程写满之前能多缓冲一些
+static constexpr int kOutputPipeSize = 256 * 1024;
+
+const char* processStatusName(ProcessStatus status) {
+    switch (status) {
+    case ProcessStatus::RUN:
+        return "RUN";
+    case ProcessStatus::RUNNING:
+        return "RUNNING";
+    case ProcessStatus::STOPPED:
+        return "STOPPED";
+    case ProcessStatus::STOPPING:
+        return "STOPPING";
+    case ProcessStatus::RELOAD:
+        return "RELOAD";
+    case ProcessStatus::RELOADING:
+        return "RELOADING";
+    case ProcessStatus::EXITED:
+        return "EXITED";
+    case ProcessStatus::DELETING:
+        return "DELETING";
+    case ProcessStatus::DELETED:
+        return "DELETED";
+    case ProcessStatus::BACKOFF:
+        return "BACKOFF";
+    case ProcessStatus::FATAL:
+        return "FATAL";
+    case ProcessStatus::UNKNOWN:
+        break;
+    }
+    return "UNKNOWN";
+}
+
+Process::~Process() {
+    generation_++;
+    timers_->Cancel(killTimer_);
+    if (auto watcher = watcher_.lock()) {
+        watcher->unwatch(pid_);
+    }
+}
+
+bool Process::openOutput(const std::shared_ptr<OutputLog>& log, int fds[2]) {
+    if (!log) {
+        return true;
+    }
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        SPDLOG_ERROR("create output pipe of {} failed, errno={}, message={}", name_, errno, strerror(errno));
+        return false;
+    }
+    // 读端由事件循环读取，写端在子进程里 dup2 到 1 或者 2
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[0], F_SETPIPE_SZ, kOutputPipeSize);
+    return true;
+}
+
+bool Process::execute(Spawner& spawner, int* pidfd) {
+    *pidfd = -1;
+    if (!commandLine_) {
+        std::string error;
+        commandLine_ = CommandLine::Parse(command_, false, &error);
+        if (!commandLine_) {
+            SPDLOG_ERROR("start process {} failed, {}, command={}", name_, error, command_);
+            status_ = ProcessStatus::EXITED;
+            generation_++;
+            return false;
+        }
+    }
+
+    std::vector<int> cgroupFds;
+    if (cgroup_) {
+        for (auto& file : CGroupRegistry::ProcsFiles(cgroup_->name())) {
+            int fd = open(file.c_str(), O_WRONLY | O_CLOEXEC);
+            if (fd == -1) {
+                SPDLOG_WARN("open {} failed, errno={}, message={}", file, errno, strerror(errno));
+                continue;
+            }
+            cgroupFds.push_back(fd);
+        }
+    }
+
+    int outFds[2] = {-1, -1};
+    int errFds[2] = {-1, -1};
+    if (!openOutput(stdoutLog_, outFds) || (!redirectStderr_ && !openOutput(stderrLog_, errFds))) {
+        for (int fd : {outFds[0], outFds[1]}) {
+            if (fd != -1) close(fd);
+        }
+        for (int fd : cgroupFds) {
+            close(fd);
+        }
+        status_ = ProcessStatus::EXITED;
+        generation_++;
+        return false;
+    }
+
+    SpawnRequest request;
+    request.path = commandLine_->path();
+    request.argv = commandLine_->argv();
+    request.envp = commandLine_->envp();
+    request.cgroupProcsFds = cgroupFds;
+    request.stdoutFd = outFds[1];
+    request.stderrFd = errFds[1];
+    request.redirectStderr = redirectStderr_;
+
+    pid_t pid = spawner.spawn(request, pidfd);
+    for (int fd : cgroupFds) {
+        close(fd);
+    }
+    // 写端只留在子进程里，子进程都退出后读端才能读到 EOF
+    for (int fd : {outFds[1], errFds[1]}) {
+        if (fd != -1) close(fd);
+    }
+    if (pid < 0) {
+        for (int fd : {outFds[0], errFds[0]}) {
+            if (fd != -1) close(fd);
+        }
+        SPDLOG_ERROR("start process {} failed, command={}, errno={}, message={}", name_, command_, -pid,
+                     strerror(-pid));
+        status_ = ProcessStatus::EXITED;
+        generation_++;
+        return false;
+    }
+
+    if (outFds[0] != -1) {
+        stdoutCapture_ = std::make_unique<OutputCapture>(loop_.get(), outFds[0], stdoutLog_);
+    }
+    if (errFds[0] != -1) {
+        stderrCapture_ = std::make_unique<OutputCapture>(loop_.get(), errFds[0], stderrLog_);
+    }
+
+    pid_ = pid;
+    startTime_ = time(nullptr);
+    status_ = ProcessStatus::RUNNING;
+    generation_++;
+    SPDLOG_INFO("process {} started, pid={}", name_, pid_);
+    return true;
+}
+
+void Process::stop() {
+    if (status_ == ProcessStatus::BACKOFF) {
+        // 取消重启
+        status_ = ProcessStatus::STOPPED;
+        generation_++;
+        return;
+    }
+    if (status_ != ProcessStatus::RUNNING || pid_ <= 0) {
+        return;
+    }
+    status_ = ProcessStatus::STOPPING;
+    generation_++;
+    signal(stopSignal_);
+
+    timers_->Cancel(killTimer_);
+    killTimer_ = timers_->Schedule(stopWait_, [this]() {
+        killTimer_ = Core::Event::TimerWheel::kInvalidTimer;
+        onStopTimeout();
+    });
+}
+
+void Process::signal(int sig) {
+    // 进程组 id 和进程 id 相同，见 Spawner
+    pid_t target = stopAsGroup_ ? -pid_ : pid_;
+    if (kill(target, sig) == -1 && errno != ESRCH) {
+        SPDLOG_ERROR("kill process {} (pid {}) failed, signal={}, errno={}", name_, target, sig, errno);
+    }
+}
+
+void Process::onStopTimeout() {
+    if (status_ != ProcessStatus::STOPPING) {
+        return;
+    }
+    SPDLOG_WARN("process {} (pid {}) did not exit in {}s, kill it", name_, pid_, stopWait_.count());
+    signal(SIGKILL);
+}
+
+void Process::onExit(int status, const struct rusage &usage) {
+    exitStatus_ = status;
+    usage_ = usage;
+    timers_->Cancel(killTimer_);
+    killTimer_ = Core::Event::TimerWheel::kInvalidTimer;
+    if (status_ == ProcessStatus::STOPPING && stopAsGroup_) {
+        // 进程组里剩下的进程不再等待
+        kill(-pid_, SIGKILL);
+    }
+    status_ = status_ == ProcessStatus::STOPPING ? ProcessStatus::STOPPED : ProcessStatus::EXITED;
+    generation_++;
+    if (WIFSIGNALED(status)) {
+        SPDLOG_INFO("process {} (pid {}) killed by signal {}", name_, pid_, WTERMSIG(status));
+    } else {
+        SPDLOG_INFO("process {} (pid {}) exited with code {}", name_, pid_, WEXITSTATUS(status));
+    }
+}
+}
+}
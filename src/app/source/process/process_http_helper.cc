@@ -1,6 +1,12 @@
 #include "process/process_http_helper.h"
 
-#include <nlohmann/json.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <event2/http.h>
+#include <event2/keyvalq_struct.h>
+#include <fmt/format.h>
+#include <iterator>
 
 #include "http/http_request.h"
 #include "http/http_action.h"
@@ -17,39 +23,197 @@ void ProcessHttpHelper::bind() {
 
     //注入路由
     manager_->getRouter()->getRequest(path, action);
+
+    std::shared_ptr<Core::Http::HttpAction> logsAction = std::make_shared<Core::Http::HttpAction>();
+    logsAction->setUsers(std::bind(&ProcessHttpHelper::handleLogs, shared_from_this(), _1, _2));
+    manager_->getRouter()->getRequest(logsPath, logsAction);
+
+    std::shared_ptr<Core::Http::HttpAction> statusAction = std::make_shared<Core::Http::HttpAction>();
+    statusAction->setUsers(std::bind(&ProcessHttpHelper::handleStatus, shared_from_this(), _1, _2));
+    manager_->getRouter()->getRequest(statusPath, statusAction);
 }
 
-void ProcessHttpHelper::handle(Core::Http::HttpRequest &/*request*/, Core::Http::HttpResponse &response) {
-    response.header("Content-Type", "application/json;charset=utf-8");
-    nlohmann::json j;
-    nlohmann::json processList;
-    if (processManager) {
-        auto& list = processManager->all();
-        for (auto iter = list.begin(); iter != list.end(); iter++) {
-            processList.push_back({
-                {"name", iter->second->name()},
-                {"pid", iter->second->getPid()},
-                {"status", iter->second->getStatus()}
-            });
+// 按 JSON 字符串转义追加到 out
+static void appendJsonString(std::string& out, const std::string& value) {
+    out.push_back('"');
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            fmt::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<int>(c));
+        } else {
+            out.push_back(c);
+        }
+    }
+    out.push_back('"');
+}
+
+// If-None-Match 可以是 *，也可以是多个 ETag
+static bool etagMatches(const std::string& ifNoneMatch, const std::string& etag) {
+    return ifNoneMatch == "*" || ifNoneMatch.find(etag) != std::string::npos;
+}
+
+void ProcessHttpHelper::initStatus() {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    etagPrefix = fmt::format("{:x}", std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+
+    statusBody.push_back('{');
+    for (auto value : {ProcessStatus::UNKNOWN, ProcessStatus::RUN, ProcessStatus::RUNNING, ProcessStatus::STOPPED,
+                       ProcessStatus::STOPPING, ProcessStatus::RELOAD, ProcessStatus::RELOADING,
+                       ProcessStatus::EXITED, ProcessStatus::DELETING, ProcessStatus::DELETED,
+                       ProcessStatus::BACKOFF, ProcessStatus::FATAL}) {
+        if (statusBody.size() > 1) {
+            statusBody.push_back(',');
         }
+        fmt::format_to(std::back_inserter(statusBody), R"("{}":{})", processStatusName(value),
+                       static_cast<int>(value));
     }
-    j.push_back({
-            {"process", processList},
-            {"status", {
-                                {"UNKNOWN", Core::Component::Process::UNKNOWN},
-                                {"RUN", Core::Component::Process::RUN},
-                                {"RUNNING", Core::Component::Process::RUNNING},
-                                {"STOPPED", Core::Component::Process::STOPPED},
-                                {"STOPPING", Core::Component::Process::STOPPING},
-                                {"RELOAD", Core::Component::Process::RELOAD},
-                                {"RELOADING", Core::Component::Process::RELOADING},
-                                {"EXITED", Core::Component::Process::EXITED},
-                                {"DELETING", Core::Component::Process::DELETING},
-                                {"DELETED", Core::Component::Process::DELETED},
-
-                        }}
-    });
-    response.response(200, j.dump());
+    statusBody.push_back('}');
+    statusETag = "\"status-" + std::to_string(std::hash<std::string>()(statusBody)) + "\"";
+}
+
+// 空串为 0，带符号、空格或者其他字符时返回 false
+static bool parseCount(const std::string& text, uint64_t* value) {
+    *value = 0;
+    if (text.empty()) {
+        return true;
+    }
+    if (text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    errno = 0;
+    char* end = nullptr;
+    *value = strtoull(text.c_str(), &end, 10);
+    return errno == 0 && *end == '\0';
+}
+
+// 只保留 text 的最后 lines 行，最后一行没有换行时也算一行
+static void keepLastLines(std::string& text, size_t lines) {
+    if (lines == 0) {
+        text.clear();
+        return;
+    }
+    size_t end = text.size();
+    if (end > 0 && text[end - 1] == '\n') {
+        end--;
+    }
+    while (end > 0) {
+        size_t pos = text.rfind('\n', end - 1);
+        if (pos == std::string::npos) {
+            return;
+        }
+        if (--lines == 0) {
+            text.erase(0, pos + 1);
+            return;
+        }
+        end = pos;
+    }
+}
+
+void ProcessHttpHelper::handleLogs(Core::Http::HttpRequest &request, Core::Http::HttpResponse &response) {
+    evkeyvalq query{};
+    evhttp_uri* uri = evhttp_uri_parse(request.getUri().c_str());
+    if (uri && evhttp_uri_get_query(uri)) {
+        evhttp_parse_query_str(evhttp_uri_get_query(uri), &query);
+    }
+    auto param = [&query](const char* key) {
+        const char* value = evhttp_find_header(&query, key);
+        return std::string(value ? value : "");
+    };
+    std::string name = param("name");
+    std::string stream = param("stream");
+    std::string since = param("since");
+    std::string tail = param("tail");
+    evhttp_clear_headers(&query);
+    if (uri) {
+        evhttp_uri_free(uri);
+    }
+
+    if (name.empty() || (!stream.empty() && stream != "stdout" && stream != "stderr")) {
+        response.header("Content-Type", "application/json;charset=utf-8");
+        response.response(400, R"({"error":"name is required, stream is stdout or stderr"})");
+        return;
+    }
+    // since 是 unix 时间戳，tail 是行数，都只能是非负整数
+    uint64_t sinceSecs = 0;
+    uint64_t tailLines = 0;
+    if (!parseCount(since, &sinceSecs) || !parseCount(tail, &tailLines)) {
+        response.header("Content-Type", "application/json;charset=utf-8");
+        response.response(400, R"({"error":"since and tail must be non-negative integers"})");
+        return;
+    }
+    auto log = processManager ? processManager->findOutputLog(name, stream == "stderr") : nullptr;
+    if (!log || !log->tail()) {
+        response.header("Content-Type", "application/json;charset=utf-8");
+        response.response(404, R"({"error":"no captured output for this process"})");
+        return;
+    }
+
+    auto tailBuffer = log->tail();
+    uint64_t from = since.empty() ? 0 : tailBuffer->Since(static_cast<time_t>(sinceSecs));
+    std::string text;
+    tailBuffer->Read(from, &text);
+    if (!tail.empty()) {
+        keepLastLines(text, tailLines);
+    }
+    response.header("Content-Type", "text/plain;charset=utf-8");
+    response.response(200, text);
+}
+
+void ProcessHttpHelper::refreshList() {
+    uint64_t generation = App::Process::Process::generation();
+    if (listCached && generation == listGeneration) {
+        return;
+    }
+    // clear 保留容量，进程数不变时不再分配内存
+    listBody.clear();
+    auto out = std::back_inserter(listBody);
+    listBody.append(R"([{"process":[)");
+    bool first = true;
+    if (processManager) {
+        processManager->forEachProcess([&](const App::Process::Process& process) {
+            if (!first) {
+                listBody.push_back(',');
+            }
+            first = false;
+            listBody.append(R"({"name":)");
+            appendJsonString(listBody, process.name());
+            listBody.append(R"(,"group":)");
+            appendJsonString(listBody, process.group());
+            fmt::format_to(out,
+                           R"(,"index":{},"pid":{},"status":{},"restarts":{},"backoff_ms":{},"oom_kills":{},)"
+                           R"("oom_killed":{}}})",
+                           process.index(), process.getPid(), static_cast<int>(process.getStatus()),
+                           process.restarts(), process.backoff().count(), process.oomKills(), process.oomKilled());
+        });
+    }
+    listBody.append("]}]");
+    listETag = fmt::format("\"{}-{:x}\"", etagPrefix, generation);
+    listGeneration = generation;
+    listCached = true;
+}
+
+void ProcessHttpHelper::handle(Core::Http::HttpRequest &request, Core::Http::HttpResponse &response) {
+    refreshList();
+    response.header("ETag", listETag);
+    if (etagMatches(request.getHeader("If-None-Match"), listETag)) {
+        response.response(304, "");
+        return;
+    }
+    response.header("Content-Type", "application/json;charset=utf-8");
+    response.response(200, listBody);
+}
+
+void ProcessHttpHelper::handleStatus(Core::Http::HttpRequest &request, Core::Http::HttpResponse &response) {
+    response.header("ETag", statusETag);
+    response.header("Cache-Control", "public, max-age=86400");
+    if (etagMatches(request.getHeader("If-None-Match"), statusETag)) {
+        response.response(304, "");
+        return;
+    }
+    response.header("Content-Type", "application/json;charset=utf-8");
+    response.response(200, statusBody);
 }
 
 }
@@ -0,0 +1,68 @@
+#include "process/restart_policy.h"
+#include <algorithm>
+#include <sys/wait.h>
+
+namespace App::Process {
+static constexpr uint32_t kDefaultMaxRestarts = 5;
+static constexpr uint32_t kDefaultWindowSecs = 60;
+static constexpr uint32_t kDefaultInitialBackoffMs = 1000;
+static constexpr uint32_t kDefaultMaxBackoffMs = 60000;
+static constexpr uint32_t kDefaultOomBackoffMs = 10000;
+static constexpr uint32_t kDefaultMaxOomRestarts = 3;
+
+RestartBackoff::RestartBackoff(const RestartPolicy &policy)
+    : mode_(policy.mode()), maxRestarts_(policy.max_restarts() > 0 ? policy.max_restarts() : kDefaultMaxRestarts),
+      window_(std::chrono::seconds(policy.window_secs() > 0 ? policy.window_secs() : kDefaultWindowSecs)),
+      initialBackoff_(policy.initial_backoff_ms() > 0 ? policy.initial_backoff_ms() : kDefaultInitialBackoffMs),
+      maxBackoff_(std::max<uint32_t>(policy.max_backoff_ms() > 0 ? policy.max_backoff_ms() : kDefaultMaxBackoffMs,
+                                     initialBackoff_.count())),
+      oomBackoff_(policy.oom_backoff_ms() > 0 ? policy.oom_backoff_ms() : kDefaultOomBackoffMs),
+      maxOomRestarts_(policy.max_oom_restarts() > 0 ? policy.max_oom_restarts() : kDefaultMaxOomRestarts) {}
+
+RestartBackoff::Decision RestartBackoff::OnExit(int status, bool oomKilled, Clock::duration uptime,
+                                                Clock::time_point now, std::chrono::milliseconds *delay) {
+  bool success = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  if (mode_ == RestartPolicy::NEVER || (mode_ == RestartPolicy::ON_FAILURE && success)) {
+    return Decision::kStop;
+  }
+
+  if (uptime >= window_) {
+    attempt_ = 0;
+    oomStreak_ = 0;
+  }
+  oomStreak_ = oomKilled ? oomStreak_ + 1 : 0;
+  while (!recent_.empty() && now - recent_.front() >= window_) {
+    recent_.pop_front();
+  }
+  if (recent_.size() >= maxRestarts_ || oomStreak_ > maxOomRestarts_) {
+    fatal_ = true;
+    return Decision::kFatal;
+  }
+
+  // equal jitter: half of the delay is fixed, the other half random
+  int64_t base = std::min<int64_t>(initialBackoff_.count() << std::min<uint32_t>(attempt_, 30), maxBackoff_.count());
+  if (oomStreak_ > 0) {
+    // give whatever else in the cgroup holds memory time to shrink
+    int64_t oomBase = oomBackoff_.count() << std::min<uint32_t>(oomStreak_ - 1, 30);
+    base = std::max(base, std::min(oomBase, std::max(maxBackoff_, oomBackoff_).count()));
+  }
+  static thread_local std::mt19937_64 random{std::random_device{}()};
+  std::uniform_int_distribution<int64_t> jitter(0, base / 2);
+  backoff_ = std::chrono::milliseconds(base - base / 2 + jitter(random));
+
+  attempt_++;
+  restarts_++;
+  recent_.push_back(now);
+  *delay = backoff_;
+  return Decision::kRestart;
+}
+
+void RestartBackoff::Reset() {
+  restarts_ = 0;
+  attempt_ = 0;
+  backoff_ = std::chrono::milliseconds(0);
+  fatal_ = false;
+  oomStreak_ = 0;
+  recent_.clear();
+}
+} // namespace App::Process
@@ -0,0 +1,137 @@
+#include "process/spawner.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <sched.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef CLONE_PIDFD
+#define CLONE_PIDFD 0x00001000
+#endif
+
+namespace App::Process {
+namespace {
+// the child only runs until execve, a small stack is enough
+constexpr size_t kChildStackSize = 64 * 1024;
+
+struct ChildArgs {
+  const SpawnRequest *request;
+  sigset_t mask;
+  // written by the child, read by the parent after the vfork returned
+  int error;
+};
+} // namespace
+
+Spawner::Spawner() {
+  long page = sysconf(_SC_PAGESIZE);
+  stackSize_ = kChildStackSize + page;
+  stack_ = mmap(nullptr, stackSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (stack_ == MAP_FAILED) {
+    SPDLOG_ERROR("Failed to map spawn stack, errno={}", errno);
+    throw std::runtime_error("Failed to map spawn stack");
+  }
+  // guard page at the bottom, the stack grows down
+  mprotect(stack_, page, PROT_NONE);
+}
+
+Spawner::~Spawner() {
+  if (stack_ != nullptr) {
+    munmap(stack_, stackSize_);
+  }
+}
+
+pid_t Spawner::spawn(const SpawnRequest &request, int *pidfd) {
+  ChildArgs args{&request, {}, 0};
+  sigemptyset(&args.mask);
+
+  // no handler of the supervisor may run on the shared address space before execve
+  sigset_t all;
+  sigset_t old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+
+  void *stackTop = static_cast<char *>(stack_) + stackSize_;
+  int fd = -1;
+  int flags = CLONE_VM | CLONE_VFORK | SIGCHLD;
+  pid_t pid = -1;
+  if (pidfdSupported_) {
+    pid = clone(childMain, stackTop, flags | CLONE_PIDFD, &args, &fd);
+    if (pid == -1 && errno == EINVAL) {
+      SPDLOG_WARN("CLONE_PIDFD is not supported, spawn without pidfd");
+      pidfdSupported_ = false;
+    }
+  }
+  if (!pidfdSupported_) {
+    pid = clone(childMain, stackTop, flags, &args);
+  }
+  int cloneErrno = errno;
+  pthread_sigmask(SIG_SETMASK, &old, nullptr);
+
+  if (pid == -1) {
+    return -cloneErrno;
+  }
+
+  if (args.error != 0) {
+    // the child failed before or in execve and has already exited
+    waitpid(pid, nullptr, 0);
+    if (fd != -1) close(fd);
+    return -args.error;
+  }
+
+  *pidfd = fd;
+  return pid;
+}
+
+bool Spawner::redirect(int fd, int target) {
+  if (fd == -1) {
+    return true;
+  }
+  if (fd == target) {
+    // dup2 onto itself keeps FD_CLOEXEC, the fd would be closed by execve
+    return fcntl(fd, F_SETFD, 0) != -1;
+  }
+  return dup2(fd, target) != -1;
+}
+
+int Spawner::childMain(void *arg) {
+  auto args = static_cast<ChildArgs *>(arg);
+  const SpawnRequest &request = *args->request;
+
+  // the service starts with default dispositions, including the ones the supervisor ignores
+  struct sigaction action {};
+  action.sa_handler = SIG_DFL;
+  sigemptyset(&action.sa_mask);
+  for (int sig = 1; sig < NSIG; sig++) {
+    sigaction(sig, &action, nullptr);
+  }
+  sigprocmask(SIG_SETMASK, &args->mask, nullptr);
+
+  // the service and everything it forks can be signaled through -pid
+  if (setpgid(0, 0) == -1) {
+    args->error = errno;
+    _exit(127);
+  }
+
+  for (int fd : request.cgroupProcsFds) {
+    if (write(fd, "0", 1) != 1) {
+      args->error = errno;
+      _exit(127);
+    }
+  }
+
+  if (!redirect(request.stdoutFd, STDOUT_FILENO) ||
+      !redirect(request.redirectStderr ? STDOUT_FILENO : request.stderrFd, STDERR_FILENO)) {
+    args->error = errno;
+    _exit(127);
+  }
+
+  execve(request.path, request.argv, request.envp);
+  args->error = errno;
+  _exit(127);
+}
+} // namespace App::Process
@@ -0,0 +1,81 @@
+#include "process/tail_buffer.h"
+#include <algorithm>
+#include <cstring>
+#include <sys/uio.h>
+
+namespace App::Process {
+TailBuffer::TailBuffer(size_t capacity)
+    : capacity_(capacity == 0 ? kDefaultCapacity : std::min(capacity, kMaxCapacity)),
+      data_(new char[capacity_]) {}
+
+void TailBuffer::Advance(uint64_t head) {
+  time_t now = time(nullptr);
+  if (now != lastMark_) {
+    // the mark points at the first byte of this write
+    marks_[nextMark_++ % kMarks] = Mark{head_, now};
+    lastMark_ = now;
+  }
+  head_ = head;
+}
+
+ssize_t TailBuffer::Fill(int fd, size_t n) {
+  n = std::min(n, capacity_);
+  size_t offset = head_ % capacity_;
+  size_t first = std::min(n, capacity_ - offset);
+  iovec iov[2] = {{data_.get() + offset, first}, {data_.get(), n - first}};
+  ssize_t count = readv(fd, iov, n > first ? 2 : 1);
+  if (count > 0) {
+    Advance(head_ + count);
+  }
+  return count;
+}
+
+void TailBuffer::Append(const char *data, size_t n) {
+  if (n > capacity_) {
+    data += n - capacity_;
+    n = capacity_;
+  }
+  size_t offset = head_ % capacity_;
+  size_t first = std::min(n, capacity_ - offset);
+  memcpy(data_.get() + offset, data, first);
+  memcpy(data_.get(), data + first, n - first);
+  Advance(head_ + n);
+}
+
+uint64_t TailBuffer::Read(uint64_t from, std::string *out) const {
+  out->clear();
+  uint64_t start = std::max(from, head_ > capacity_ ? head_ - capacity_ : 0);
+  if (start >= head_) {
+    return head_;
+  }
+  size_t n = head_ - start;
+  size_t offset = start % capacity_;
+  size_t first = std::min<size_t>(n, capacity_ - offset);
+  out->reserve(n);
+  out->append(data_.get() + offset, first);
+  out->append(data_.get(), n - first);
+  return start;
+}
+
+uint64_t TailBuffer::Since(time_t t) const {
+  uint64_t position = head_;
+  size_t marks = 0;
+  bool older = false;
+  for (auto &mark : marks_) {
+    if (mark.time == 0) {
+      continue;
+    }
+    marks++;
+    if (mark.time >= t) {
+      position = std::min(position, mark.position);
+    } else {
+      older = true;
+    }
+  }
+  // every mark is newer than t, but the ones before them were overwritten and may have been too
+  if (marks == kMarks && !older) {
+    return 0;
+  }
+  return position;
+}
+} // namespace App::Process
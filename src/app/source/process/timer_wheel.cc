@@ -0,0 +1,196 @@
+#include "process/timer_wheel.h"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+namespace Core::Event {
+TimerWheel::TimerWheel(EventLoop *loop, std::chrono::milliseconds tick)
+    : loop_(loop), tick_(std::max(tick, std::chrono::milliseconds(1))), origin_(std::chrono::steady_clock::now()) {
+  heads_.fill(kNil);
+  event *ev = evtimer_new(loop_->getEventBase(), TickFn, this);
+  if (ev == nullptr) {
+    SPDLOG_ERROR("Failed to create timer wheel event");
+    throw std::runtime_error("Failed to create timer wheel event");
+  }
+  event_.Reset(ev);
+}
+
+int64_t TimerWheel::NowTick() const { return (std::chrono::steady_clock::now() - origin_) / tick_; }
+
+TimerWheel::TimerId TimerWheel::Schedule(std::chrono::milliseconds delay, Task &&task) {
+  auto now = std::chrono::steady_clock::now();
+  if (size_ == 0) {
+    // nothing pending, the wheel did not turn while idle. Never backwards: from a callback in
+    // Advance, or right after it, current_ is already one tick past now
+    current_ = std::max<int64_t>(current_, (now - origin_) / tick_);
+  }
+
+  uint32_t index;
+  if (!free_.empty()) {
+    index = free_.back();
+    free_.pop_back();
+  } else {
+    index = static_cast<uint32_t>(nodes_.size());
+    nodes_.emplace_back();
+  }
+
+  // round up, a timer never fires early
+  auto deadline = now - origin_ + std::max(delay, std::chrono::milliseconds(0));
+  Node &node = nodes_[index];
+  node.task = std::move(task);
+  node.expire = (deadline + tick_ - std::chrono::steady_clock::duration(1)) / tick_;
+  Place(index);
+  size_++;
+  Rearm();
+  return static_cast<TimerId>(node.generation) << 32 | index;
+}
+
+bool TimerWheel::Cancel(TimerId id) {
+  auto index = static_cast<uint32_t>(id);
+  auto generation = static_cast<uint32_t>(id >> 32);
+  if (index >= nodes_.size() || nodes_[index].generation != generation || nodes_[index].list == kNil) {
+    return false;
+  }
+  Unlink(index);
+  nodes_[index].task.Reset();
+  Release(index);
+  size_--;
+  return true;
+}
+
+void TimerWheel::Link(uint32_t index, uint32_t list) {
+  Node &node = nodes_[index];
+  node.list = list;
+  node.prev = kNil;
+  node.next = heads_[list];
+  if (node.next != kNil) {
+    nodes_[node.next].prev = index;
+  }
+  heads_[list] = index;
+  if (list < kCascadeList) {
+    occupied_[list / kSlots] |= uint64_t(1) << (list % kSlots);
+  }
+}
+
+void TimerWheel::Unlink(uint32_t index) {
+  Node &node = nodes_[index];
+  if (node.prev != kNil) {
+    nodes_[node.prev].next = node.next;
+  } else {
+    heads_[node.list] = node.next;
+  }
+  if (node.next != kNil) {
+    nodes_[node.next].prev = node.prev;
+  }
+  if (heads_[node.list] == kNil && node.list < kCascadeList) {
+    occupied_[node.list / kSlots] &= ~(uint64_t(1) << (node.list % kSlots));
+  }
+  node.prev = node.next = node.list = kNil;
+}
+
+void TimerWheel::Release(uint32_t index) {
+  Node &node = nodes_[index];
+  if (++node.generation == 0) {
+    node.generation = 1;
+  }
+  free_.push_back(index);
+}
+
+void TimerWheel::Place(uint32_t index) {
+  int64_t expire = std::max(nodes_[index].expire, current_);
+  int64_t delta = expire - current_;
+  for (int level = 0; level < kLevels; level++) {
+    if (delta < int64_t(1) << (kSlotBits * (level + 1))) {
+      Link(index, level * kSlots + ((expire >> (kSlotBits * level)) & (kSlots - 1)));
+      return;
+    }
+  }
+  // beyond the wheel, park it in the farthest bucket and place it again when that is cascaded
+  expire = current_ + (int64_t(1) << (kSlotBits * kLevels)) - 1;
+  int level = kLevels - 1;
+  Link(index, level * kSlots + ((expire >> (kSlotBits * level)) & (kSlots - 1)));
+}
+
+void TimerWheel::Cascade(int level, uint32_t slot) {
+  uint32_t list = level * kSlots + slot;
+  // detach first, a node can land in the same bucket again
+  while (heads_[list] != kNil) {
+    uint32_t index = heads_[list];
+    Unlink(index);
+    Link(index, kCascadeList);
+  }
+  while (heads_[kCascadeList] != kNil) {
+    uint32_t index = heads_[kCascadeList];
+    Unlink(index);
+    Place(index);
+  }
+}
+
+void TimerWheel::Advance(int64_t target) {
+  while (current_ <= target) {
+    if (size_ == 0) {
+      current_ = target + 1;
+      return;
+    }
+
+    // higher levels first, so their nodes can still drop into the lower buckets of this tick
+    for (int level = kLevels - 1; level > 0; level--) {
+      if ((current_ & ((int64_t(1) << (kSlotBits * level)) - 1)) == 0) {
+        Cascade(level, (current_ >> (kSlotBits * level)) & (kSlots - 1));
+      }
+    }
+
+    uint32_t list = current_ & (kSlots - 1);
+    while (heads_[list] != kNil) {
+      uint32_t index = heads_[list];
+      Unlink(index);
+      Link(index, kExpiredList);
+    }
+    // timers scheduled by the callbacks below belong to the next tick at the earliest
+    current_++;
+
+    while (heads_[kExpiredList] != kNil) {
+      uint32_t index = heads_[kExpiredList];
+      Unlink(index);
+      Task task = std::move(nodes_[index].task);
+      Release(index);
+      size_--;
+      task();
+    }
+  }
+}
+
+void TimerWheel::Rearm() {
+  if (size_ == 0) {
+    event_del(event_.get());
+    return;
+  }
+
+  constexpr int64_t kNever = INT64_MAX;
+  auto offset = static_cast<uint32_t>(current_ & (kSlots - 1));
+  int64_t distance = kNever;
+  if (occupied_[0] != 0) {
+    uint64_t rotated = offset == 0 ? occupied_[0] : (occupied_[0] >> offset) | (occupied_[0] << (kSlots - offset));
+    distance = __builtin_ctzll(rotated);
+  }
+  for (int level = 1; level < kLevels; level++) {
+    if (occupied_[level] != 0) {
+      // the next cascade happens when level 0 wraps around
+      distance = std::min<int64_t>(distance, offset == 0 ? 0 : kSlots - offset);
+      break;
+    }
+  }
+
+  auto wakeup = origin_ + (current_ + distance) * tick_;
+  auto timeout = std::max(wakeup - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration(0));
+  auto micros = std::chrono::duration_cast<std::chrono::microseconds>(timeout).count();
+  struct timeval tv {static_cast<time_t>(micros / 1000000), static_cast<suseconds_t>(micros % 1000000)};
+  event_add(event_.get(), &tv);
+}
+
+void TimerWheel::TickFn(evutil_socket_t, short, void *handler) {
+  auto wheel = static_cast<TimerWheel *>(handler);
+  wheel->Advance(wheel->NowTick());
+  wheel->Rearm();
+}
+} // namespace Core::Event
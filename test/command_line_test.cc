@@ -0,0 +1,155 @@
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "process/command_line.h"
+
+namespace App::Process {
+namespace {
+std::vector<std::string> Argv(const CommandLine &line) {
+  std::vector<std::string> args;
+  for (char *const *arg = line.argv(); *arg != nullptr; arg++) {
+    args.emplace_back(*arg);
+  }
+  return args;
+}
+
+struct SplitCase {
+  const char *command;
+  std::vector<std::string> args;
+};
+
+// commands run directly, split into words without any expansion
+const SplitCase kSplitCases[] = {
+    {"/bin/echo", {"/bin/echo"}},
+    {"/bin/echo a b", {"/bin/echo", "a", "b"}},
+    {"  /bin/echo \t a  \t b  ", {"/bin/echo", "a", "b"}},
+    {"/bin/echo 'a b' \"c d\"", {"/bin/echo", "a b", "c d"}},
+    {"/bin/echo a'b c'd", {"/bin/echo", "ab cd"}},
+    {"/bin/echo '' \"\"", {"/bin/echo", "", ""}},
+    {"/bin/echo a\\ b", {"/bin/echo", "a b"}},
+    {"/bin/echo \\$HOME \\| \\*", {"/bin/echo", "$HOME", "|", "*"}},
+    {"/bin/echo '$HOME | * ; `id`'", {"/bin/echo", "$HOME | * ; `id`"}},
+    {"/bin/echo 'a\\b'", {"/bin/echo", "a\\b"}},
+    // inside double quotes a backslash only escapes $ ` " and itself
+    {"/bin/echo \"a\\\"b\" \"c\\\\d\" \"e\\nf\"", {"/bin/echo", "a\"b", "c\\d", "e\\nf"}},
+    {"/bin/echo \"a | b ; c * d\"", {"/bin/echo", "a | b ; c * d"}},
+    // ~ and # only mean something at the beginning of a word
+    {"/bin/echo a~b a#b", {"/bin/echo", "a~b", "a#b"}},
+    // only a VAR= before the binary is an assignment
+    {"/bin/echo --name=value x=1", {"/bin/echo", "--name=value", "x=1"}},
+};
+
+// commands that need /bin/sh -c
+const char *const kShellCases[] = {
+    "/bin/echo a | /bin/cat",
+    "/bin/echo a & /bin/echo b",
+    "/bin/echo a && /bin/echo b",
+    "/bin/echo a; /bin/echo b",
+    "/bin/cat < /dev/null",
+    "/bin/echo a > /dev/null",
+    "(/bin/echo a)",
+    "/bin/echo $HOME",
+    "/bin/echo ${HOME}",
+    "/bin/echo `id`",
+    "/bin/echo $(id)",
+    "/bin/echo *",
+    "/bin/echo ?",
+    "/bin/echo [ab]",
+    "/bin/echo {a,b}",
+    "/bin/echo a\n/bin/echo b",
+    "/bin/echo \"$HOME\"",
+    "/bin/echo \"`id`\"",
+    "A=1 /bin/echo a",
+    "~/bin/run",
+    "/bin/echo ~",
+    "/bin/echo a #comment",
+    "#/bin/echo",
+};
+
+const char *const kErrorCases[] = {
+    "",
+    "  \t ",
+    "/bin/echo 'a",
+    "/bin/echo \"a",
+    "/bin/echo \"a\\\"",
+    "/bin/echo a\\",
+    "/nonexistent/watchermen-test",
+    "watchermen-test-nonexistent-binary",
+    // has a slash, so it is taken as a path and not as an assignment
+    "/tmp/A=1",
+};
+
+TEST(CommandLineTest, Split) {
+  for (const auto &test : kSplitCases) {
+    SCOPED_TRACE(test.command);
+    std::string error;
+    auto line = CommandLine::Parse(test.command, false, &error);
+    ASSERT_NE(line, nullptr) << error;
+    EXPECT_FALSE(line->shell());
+    EXPECT_STREQ(line->path(), "/bin/echo");
+    EXPECT_EQ(Argv(*line), test.args);
+  }
+}
+
+TEST(CommandLineTest, ShellFallback) {
+  for (const char *command : kShellCases) {
+    SCOPED_TRACE(command);
+    std::string error;
+    auto line = CommandLine::Parse(command, false, &error);
+    ASSERT_NE(line, nullptr) << error;
+    EXPECT_TRUE(line->shell());
+    EXPECT_FALSE(line->shellRequested());
+    EXPECT_STREQ(line->path(), "/bin/sh");
+    EXPECT_EQ(Argv(*line), (std::vector<std::string>{"sh", "-c", command}));
+  }
+}
+
+TEST(CommandLineTest, ShellRequested) {
+  std::string error;
+  auto line = CommandLine::Parse("/bin/echo a", true, &error);
+  ASSERT_NE(line, nullptr) << error;
+  EXPECT_TRUE(line->shell());
+  EXPECT_TRUE(line->shellRequested());
+  EXPECT_STREQ(line->path(), "/bin/sh");
+  EXPECT_EQ(Argv(*line), (std::vector<std::string>{"sh", "-c", "/bin/echo a"}));
+}
+
+TEST(CommandLineTest, Errors) {
+  for (const char *command : kErrorCases) {
+    SCOPED_TRACE(command);
+    std::string error;
+    EXPECT_EQ(CommandLine::Parse(command, false, &error), nullptr);
+    EXPECT_FALSE(error.empty());
+  }
+}
+
+TEST(CommandLineTest, ResolvesThroughPath) {
+  std::string error;
+  auto line = CommandLine::Parse("sh -c true", false, &error);
+  ASSERT_NE(line, nullptr) << error;
+  EXPECT_FALSE(line->shell());
+  std::string path = line->path();
+  EXPECT_TRUE(path.size() > 3 && path.compare(path.size() - 3, 3, "/sh") == 0) << path;
+  EXPECT_EQ(Argv(*line), (std::vector<std::string>{"sh", "-c", "true"}));
+  EXPECT_EQ(line->command(), "sh -c true");
+}
+
+TEST(CommandLineTest, PassesEnvironment) {
+  std::string error;
+  auto line = CommandLine::Parse("/bin/echo", false, &error);
+  ASSERT_NE(line, nullptr) << error;
+  size_t count = 0;
+  for (char *const *env = line->envp(); *env != nullptr; env++) {
+    count++;
+  }
+  size_t expected = 0;
+  for (char **env = environ; *env != nullptr; env++) {
+    expected++;
+  }
+  EXPECT_EQ(count, expected);
+}
+} // namespace
+} // namespace App::Process
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "process/config_diff.h"
+
+namespace App::Process {
+namespace {
+using Services = google::protobuf::RepeatedPtrField<ProcessConfig>;
+
+ProcessConfig *AddService(Services *services, const std::string &name) {
+  auto service = services->Add();
+  service->set_process_name(name);
+  service->set_command("/bin/" + name);
+  service->set_numprocs(1);
+  auto cgroup = service->mutable_cgroup();
+  cgroup->set_enabled(true);
+  cgroup->set_name(name);
+  cgroup->set_memory(256);
+  cgroup->set_cpu(0.5);
+  return service;
+}
+
+std::vector<std::string> Names(const std::vector<const ProcessConfig *> &services) {
+  std::vector<std::string> names;
+  for (auto service : services) {
+    names.push_back(service->process_name());
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+std::vector<std::string> Sorted(std::vector<std::string> names) {
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+class ConfigDiffTest : public testing::Test {
+protected:
+  void SetUp() override {
+    for (const char *name : {"a", "b", "c"}) {
+      AddService(&loaded_, name);
+      AddService(&next_, name);
+    }
+    index_ = IndexServices(&loaded_);
+  }
+
+  ServiceChangeSet Diff() { return DiffServices(index_, &next_, &nextIndex_); }
+
+  ProcessConfig *Next(const std::string &name) {
+    for (auto &service : next_) {
+      if (service.process_name() == name) {
+        return &service;
+      }
+    }
+    return nullptr;
+  }
+
+  Services loaded_;
+  Services next_;
+  FingerprintIndex index_;
+  FingerprintIndex nextIndex_;
+};
+
+TEST_F(ConfigDiffTest, Unchanged) {
+  auto changes = Diff();
+  EXPECT_TRUE(changes.empty());
+  EXPECT_EQ(nextIndex_.size(), 3u);
+}
+
+TEST_F(ConfigDiffTest, OrderDoesNotMatter) {
+  next_.SwapElements(0, 2);
+  EXPECT_TRUE(Diff().empty());
+}
+
+TEST_F(ConfigDiffTest, Added) {
+  AddService(&next_, "d");
+  AddService(&next_, "e");
+  auto changes = Diff();
+  EXPECT_EQ(Names(changes.added), (std::vector<std::string>{"d", "e"}));
+  EXPECT_TRUE(changes.removed.empty());
+  EXPECT_TRUE(changes.restart.empty());
+  EXPECT_TRUE(changes.hot.empty());
+  EXPECT_EQ(nextIndex_.size(), 5u);
+}
+
+TEST_F(ConfigDiffTest, Removed) {
+  next_.RemoveLast();
+  next_.SwapElements(0, 1);
+  next_.RemoveLast();
+  auto changes = Diff();
+  EXPECT_EQ(Sorted(changes.removed), (std::vector<std::string>{"a", "c"}));
+  EXPECT_TRUE(changes.added.empty());
+  EXPECT_TRUE(changes.restart.empty());
+  EXPECT_TRUE(changes.hot.empty());
+  EXPECT_EQ(nextIndex_.size(), 1u);
+}
+
+TEST_F(ConfigDiffTest, Restart) {
+  Next("a")->set_command("/bin/a --flag");
+  Next("b")->set_numprocs(2);
+  Next("c")->mutable_restart()->set_mode(RestartPolicy::ALWAYS);
+  auto changes = Diff();
+  EXPECT_EQ(Names(changes.restart), (std::vector<std::string>{"a", "b", "c"}));
+  EXPECT_TRUE(changes.added.empty());
+  EXPECT_TRUE(changes.removed.empty());
+  EXPECT_TRUE(changes.hot.empty());
+}
+
+TEST_F(ConfigDiffTest, LimitsOnlyChangeIsHot) {
+  Next("a")->mutable_cgroup()->set_memory(512);
+  Next("b")->mutable_cgroup()->set_cpu(2);
+  auto changes = Diff();
+  EXPECT_EQ(Names(changes.hot), (std::vector<std::string>{"a", "b"}));
+  EXPECT_TRUE(changes.added.empty());
+  EXPECT_TRUE(changes.removed.empty());
+  EXPECT_TRUE(changes.restart.empty());
+}
+
+TEST_F(ConfigDiffTest, CGroupPlacementChangeRestarts) {
+  Next("a")->mutable_cgroup()->set_enabled(false);
+  Next("b")->mutable_cgroup()->set_name("other");
+  // a limits change on top of a restart is not reported twice
+  Next("b")->mutable_cgroup()->set_memory(512);
+  auto changes = Diff();
+  EXPECT_EQ(Names(changes.restart), (std::vector<std::string>{"a", "b"}));
+  EXPECT_TRUE(changes.hot.empty());
+}
+
+TEST_F(ConfigDiffTest, CGroupDroppedRestarts) {
+  Next("a")->clear_cgroup();
+  auto changes = Diff();
+  EXPECT_EQ(Names(changes.restart), (std::vector<std::string>{"a"}));
+  EXPECT_TRUE(changes.hot.empty());
+}
+
+TEST_F(ConfigDiffTest, CGroupAddedRestarts) {
+  loaded_.Mutable(0)->clear_cgroup();
+  index_ = IndexServices(&loaded_);
+  auto changes = Diff();
+  EXPECT_EQ(Names(changes.restart), (std::vector<std::string>{"a"}));
+  EXPECT_TRUE(changes.hot.empty());
+}
+
+TEST_F(ConfigDiffTest, InvalidServicesSkipped) {
+  AddService(&next_, "")->set_command("/bin/nameless");
+  AddService(&next_, "d")->clear_command();
+  // an invalid service does not count as loaded either, so it goes away silently
+  Next("a")->clear_command();
+  auto changes = Diff();
+  EXPECT_TRUE(changes.added.empty());
+  EXPECT_TRUE(changes.restart.empty());
+  EXPECT_TRUE(changes.hot.empty());
+  EXPECT_EQ(changes.removed, std::vector<std::string>{"a"});
+  EXPECT_EQ(nextIndex_.size(), 2u);
+  EXPECT_FALSE(nextIndex_.contains(""));
+  EXPECT_FALSE(nextIndex_.contains("d"));
+
+  Services invalid;
+  AddService(&invalid, "")->set_command("/bin/nameless");
+  AddService(&invalid, "d")->clear_command();
+  EXPECT_TRUE(IndexServices(&invalid).empty());
+}
+
+TEST_F(ConfigDiffTest, FingerprintLeavesServiceIntact) {
+  auto service = Next("a");
+  std::string before = service->SerializeAsString();
+  auto cgroup = &service->cgroup();
+  auto first = FingerprintService(service);
+  EXPECT_EQ(service->SerializeAsString(), before);
+  // the cgroup is borrowed, not copied
+  EXPECT_EQ(&service->cgroup(), cgroup);
+
+  auto second = FingerprintService(service);
+  EXPECT_EQ(first.restart, second.restart);
+  EXPECT_EQ(first.limits, second.limits);
+}
+
+TEST_F(ConfigDiffTest, FingerprintWithoutCGroup) {
+  auto service = Next("a");
+  service->clear_cgroup();
+  auto fingerprint = FingerprintService(service);
+  EXPECT_FALSE(service->has_cgroup());
+  EXPECT_EQ(fingerprint.limits, 0u);
+}
+} // namespace
+} // namespace App::Process
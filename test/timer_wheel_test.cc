@@ -0,0 +1,201 @@
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <event/event_loop.h>
+#include <gtest/gtest.h>
+
+#include "process/timer_wheel.h"
+
+namespace Core::Event {
+/**
+ * Drives the wheel with a fake clock: the origin is moved back instead of waiting, and the tick
+ * callback is run by hand. The tick is one minute, so the real time spent by a test never reaches
+ * the next tick.
+ */
+class TimerWheelTest : public testing::Test {
+protected:
+  static constexpr std::chrono::milliseconds kTick = std::chrono::minutes(1);
+  static constexpr int64_t kLevel1 = 64;
+  static constexpr int64_t kLevel2 = 64 * 64;
+  static constexpr int64_t kWheelSpan = int64_t(1) << 24;
+
+  // a delay that expires exactly ticks ticks from now
+  static std::chrono::milliseconds Ticks(int64_t ticks) { return ticks * kTick - kTick / 2; }
+
+  // the clock moves forward and the libevent timer fires
+  void Turn(int64_t ticks) {
+    Skip(ticks);
+    TimerWheel::TickFn(-1, 0, &wheel_);
+  }
+
+  // the clock moves forward, nothing runs
+  void Skip(int64_t ticks) { wheel_.origin_ -= ticks * wheel_.tick_; }
+
+  int64_t Now() const { return wheel_.NowTick(); }
+
+  // the tick being processed, from inside a callback
+  int64_t Firing() const { return wheel_.current_ - 1; }
+
+  TimerWheel::TimerId Record(int64_t delay) {
+    return wheel_.Schedule(Ticks(delay), [this]() { fired_.push_back(Firing()); });
+  }
+
+  std::shared_ptr<EventLoop> loop_ = std::make_shared<EventLoop>();
+  TimerWheel wheel_{loop_.get(), kTick};
+  std::vector<int64_t> fired_;
+};
+
+TEST_F(TimerWheelTest, FiresOnLevelBoundaries) {
+  for (int64_t delay : {int64_t(1), kLevel1 - 1, kLevel1, kLevel1 + 1, 2 * kLevel1, kLevel2 - 1, kLevel2, kLevel2 + 1,
+                        kLevel2 * kLevel1 - 1, kLevel2 * kLevel1, kLevel2 * kLevel1 + 1}) {
+    SCOPED_TRACE(delay);
+    fired_.clear();
+    int64_t base = Now();
+    Record(delay);
+    Turn(delay - 1);
+    EXPECT_TRUE(fired_.empty());
+    Turn(1);
+    EXPECT_EQ(fired_, std::vector<int64_t>{base + delay});
+    EXPECT_EQ(wheel_.Size(), 0u);
+  }
+}
+
+TEST_F(TimerWheelTest, FiresOnLevelBoundariesTickByTick) {
+  // not aligned to a level, so the cascades happen while timers are pending
+  Turn(kLevel2 - 10);
+  int64_t base = Now();
+  std::vector<int64_t> expected;
+  for (int64_t delay : {kLevel1 - 1, kLevel1, kLevel1 + 1, kLevel2 - 1, kLevel2, kLevel2 + 1, kLevel2 + kLevel1}) {
+    Record(delay);
+    Record(delay);
+    expected.push_back(base + delay);
+    expected.push_back(base + delay);
+  }
+  while (Now() < base + kLevel2 + kLevel1) {
+    Turn(1);
+  }
+  EXPECT_EQ(fired_, expected);
+  EXPECT_EQ(wheel_.Size(), 0u);
+}
+
+TEST_F(TimerWheelTest, FiresBeyondTheWheel) {
+  int64_t base = Now();
+  Record(kWheelSpan + 100);
+  Record(2 * kWheelSpan + 5);
+  Turn(kWheelSpan + 99);
+  EXPECT_TRUE(fired_.empty());
+  Turn(1);
+  EXPECT_EQ(fired_, std::vector<int64_t>{base + kWheelSpan + 100});
+  Turn(kWheelSpan - 96);
+  EXPECT_EQ(fired_.size(), 1u);
+  Turn(1);
+  EXPECT_EQ(fired_, (std::vector<int64_t>{base + kWheelSpan + 100, base + 2 * kWheelSpan + 5}));
+}
+
+TEST_F(TimerWheelTest, CatchesUpAfterIdle) {
+  Turn(3);
+  // nothing pending, the libevent timer is not armed and the wheel does not turn
+  Skip(kLevel2 + 7);
+  int64_t base = Now();
+  Record(2);
+  Turn(1);
+  EXPECT_TRUE(fired_.empty());
+  Turn(1);
+  EXPECT_EQ(fired_, std::vector<int64_t>{base + 2});
+}
+
+TEST_F(TimerWheelTest, CancelAfterFire) {
+  auto id = Record(1);
+  Turn(1);
+  ASSERT_EQ(fired_.size(), 1u);
+  EXPECT_FALSE(wheel_.Cancel(id));
+
+  // the slot is reused, the old id must not cancel the new timer
+  auto reused = Record(1);
+  EXPECT_NE(reused, id);
+  EXPECT_FALSE(wheel_.Cancel(id));
+  EXPECT_EQ(wheel_.Size(), 1u);
+  Turn(1);
+  EXPECT_EQ(fired_.size(), 2u);
+  EXPECT_FALSE(wheel_.Cancel(reused));
+  EXPECT_FALSE(wheel_.Cancel(TimerWheel::kInvalidTimer));
+}
+
+TEST_F(TimerWheelTest, CancelBeforeFire) {
+  std::vector<TimerWheel::TimerId> ids;
+  for (int64_t delay : {int64_t(1), kLevel1, kLevel2, kWheelSpan + 1}) {
+    ids.push_back(Record(delay));
+  }
+  EXPECT_EQ(wheel_.Size(), ids.size());
+  for (auto id : ids) {
+    EXPECT_TRUE(wheel_.Cancel(id));
+    EXPECT_FALSE(wheel_.Cancel(id));
+  }
+  EXPECT_EQ(wheel_.Size(), 0u);
+  Turn(kLevel2 + 1);
+  EXPECT_TRUE(fired_.empty());
+}
+
+TEST_F(TimerWheelTest, CancelFromCallback) {
+  TimerWheel::TimerId second = TimerWheel::kInvalidTimer;
+  bool cancelled = false;
+  wheel_.Schedule(Ticks(kLevel1), [&]() { cancelled = wheel_.Cancel(second); });
+  // due in the same tick, already moved to the expired list when the first one runs
+  second = Record(kLevel1);
+  Turn(kLevel1);
+  EXPECT_TRUE(cancelled);
+  EXPECT_TRUE(fired_.empty());
+  EXPECT_EQ(wheel_.Size(), 0u);
+}
+
+TEST_F(TimerWheelTest, RescheduleFromCallback) {
+  int64_t base = Now();
+  std::function<void()> again = [&]() {
+    fired_.push_back(Firing());
+    if (fired_.size() < 3) {
+      wheel_.Schedule(Ticks(kLevel1), again);
+    }
+  };
+  wheel_.Schedule(Ticks(kLevel1), again);
+  while (Now() < base + 4 * kLevel1) {
+    Turn(1);
+  }
+  EXPECT_EQ(fired_, (std::vector<int64_t>{base + kLevel1, base + 2 * kLevel1, base + 3 * kLevel1}));
+}
+
+TEST_F(TimerWheelTest, RescheduleWithoutDelayRunsOnTheNextTick) {
+  int64_t base = Now();
+  wheel_.Schedule(Ticks(1), [this]() {
+    fired_.push_back(Firing());
+    wheel_.Schedule(std::chrono::milliseconds(0), [this]() { fired_.push_back(Firing()); });
+  });
+  Turn(1);
+  EXPECT_EQ(fired_, std::vector<int64_t>{base + 1});
+  Turn(1);
+  EXPECT_EQ(fired_, (std::vector<int64_t>{base + 1, base + 2}));
+}
+
+TEST_F(TimerWheelTest, WheelTimerRearmsFromCallback) {
+  int count = 0;
+  std::unique_ptr<WheelTimer> timer;
+  timer = std::make_unique<WheelTimer>(&wheel_, [&]() {
+    count++;
+    EXPECT_FALSE(timer->enabled());
+    timer->enable(Ticks(2));
+  });
+  timer->enable(Ticks(2));
+  Turn(2);
+  EXPECT_EQ(count, 1);
+  EXPECT_TRUE(timer->enabled());
+  Turn(2);
+  EXPECT_EQ(count, 2);
+  timer->disable();
+  EXPECT_FALSE(timer->enabled());
+  Turn(2);
+  EXPECT_EQ(count, 2);
+  EXPECT_EQ(wheel_.Size(), 0u);
+}
+} // namespace Core::Event